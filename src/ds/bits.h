@@ -129,6 +129,20 @@ namespace snmalloc
 #endif
     }
 
+    /**
+     * Start loading the cache line at `p`, to be read soon.
+     */
+    inline void prefetch(void* p)
+    {
+#if defined(_MSC_VER) && defined(PLATFORM_IS_X86)
+      _mm_prefetch((const char*)p, _MM_HINT_T0);
+#elif __has_builtin(__builtin_prefetch) || defined(__GNUC__)
+      __builtin_prefetch(p);
+#else
+      UNUSED(p);
+#endif
+    }
+
     inline uint64_t benchmark_time_start()
     {
       halt_out_of_order();
@@ -252,6 +266,19 @@ namespace snmalloc
       return n;
     }
 
+    inline size_t ctz64(uint64_t x)
+    {
+      if constexpr (is64())
+      {
+        return ctz((size_t)x);
+      }
+      else
+      {
+        size_t low = (size_t)x;
+        return (low != 0) ? ctz(low) : 32 + ctz((size_t)(x >> 32));
+      }
+    }
+
     inline size_t umul(size_t x, size_t y, bool& overflow)
     {
 #if __has_builtin(__builtin_mul_overflow)
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "bits.h"
+
+#include <algorithm>
+#include <string.h>
+#ifdef _WIN32
+#  include <fcntl.h>
+#  include <io.h>
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+namespace snmalloc
+{
+  /**
+   * Buffered text output to a file descriptor.  This never allocates, so it
+   * can be used from inside the allocator, for example to write reports
+   * while holding allocator locks.
+   */
+  class FdWriter
+  {
+    int fd;
+    size_t used = 0;
+    char buffer[1024];
+
+    static int os_write(int f, const char* p, size_t len)
+    {
+#ifdef _WIN32
+      return _write(f, p, (unsigned int)len);
+#else
+      return (int)::write(f, p, len);
+#endif
+    }
+
+  public:
+    FdWriter(int f) : fd(f) {}
+
+    ~FdWriter()
+    {
+      flush();
+    }
+
+    /**
+     * Open `path` for writing, truncating it unless `append` is set.  Returns
+     * a negative value on failure.
+     */
+    static int open(const char* path, bool append = false)
+    {
+#ifdef _WIN32
+      int mode = append ? _O_APPEND : _O_TRUNC;
+      return _open(path, _O_WRONLY | _O_CREAT | _O_BINARY | mode, 0644);
+#else
+      int mode = append ? O_APPEND : O_TRUNC;
+      return ::open(path, O_WRONLY | O_CREAT | O_CLOEXEC | mode, 0644);
+#endif
+    }
+
+    static void close(int f)
+    {
+#ifdef _WIN32
+      _close(f);
+#else
+      ::close(f);
+#endif
+    }
+
+    void flush()
+    {
+      size_t done = 0;
+
+      while (done < used)
+      {
+        int n = os_write(fd, buffer + done, used - done);
+
+        if (n <= 0)
+          break;
+
+        done += (size_t)n;
+      }
+
+      used = 0;
+    }
+
+    FdWriter& write(const char* p, size_t len)
+    {
+      while (len > 0)
+      {
+        if (used == sizeof(buffer))
+          flush();
+
+        size_t n = (std::min)(len, sizeof(buffer) - used);
+        memcpy(buffer + used, p, n);
+        used += n;
+        p += n;
+        len -= n;
+      }
+
+      return *this;
+    }
+
+    FdWriter& operator<<(const char* s)
+    {
+      return write(s, strlen(s));
+    }
+
+    FdWriter& operator<<(char c)
+    {
+      return write(&c, 1);
+    }
+
+    FdWriter& operator<<(size_t n)
+    {
+      char digits[24];
+      size_t i = sizeof(digits);
+
+      do
+      {
+        digits[--i] = (char)('0' + (n % 10));
+        n /= 10;
+      } while (n != 0);
+
+      return write(digits + i, sizeof(digits) - i);
+    }
+
+    /**
+     * Write `n` in hexadecimal, with a `0x` prefix.
+     */
+    FdWriter& hex(size_t n)
+    {
+      char digits[2 + (bits::BITS / 4)];
+      size_t i = sizeof(digits);
+
+      do
+      {
+        digits[--i] = "0123456789abcdef"[n & 0xf];
+        n >>= 4;
+      } while (n != 0);
+
+      digits[--i] = 'x';
+      digits[--i] = '0';
+      return write(digits + i, sizeof(digits) - i);
+    }
+
+    /**
+     * Copy the contents of the file at `path`, if it can be read.
+     */
+    void append_file(const char* path)
+    {
+#ifdef _WIN32
+      int in = _open(path, _O_RDONLY | _O_BINARY);
+#else
+      int in = ::open(path, O_RDONLY | O_CLOEXEC);
+#endif
+      if (in < 0)
+        return;
+
+      while (true)
+      {
+        if (used == sizeof(buffer))
+          flush();
+
+#ifdef _WIN32
+        int n = _read(in, buffer + used, (unsigned int)(sizeof(buffer) - used));
+#else
+        int n = (int)::read(in, buffer + used, sizeof(buffer) - used);
+#endif
+        if (n <= 0)
+          break;
+
+        used += (size_t)n;
+      }
+
+      close(in);
+    }
+  };
+}
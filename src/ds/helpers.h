@@ -11,13 +11,13 @@ namespace snmalloc
   template<class Object, Object init() noexcept>
   class Singleton
   {
+    inline static std::atomic_flag flag;
+    inline static std::atomic<bool> initialised;
+    inline static Object obj;
+
   public:
     inline static Object& get()
     {
-      static std::atomic_flag flag;
-      static std::atomic<bool> initialised;
-      static Object obj;
-
       if (!initialised.load(std::memory_order_acquire))
       {
         FlagLock lock(flag);
@@ -29,5 +29,14 @@ namespace snmalloc
       }
       return obj;
     }
+
+    /**
+     * Returns true if `get` has already created the object.  Unlike `get`,
+     * this never creates it.
+     */
+    inline static bool is_initialised()
+    {
+      return initialised.load(std::memory_order_acquire);
+    }
   };
 }
@@ -91,6 +91,46 @@ namespace snmalloc
       return std::make_pair(next, tl);
     }
 
+    /**
+     * Pass each message that has been completely pushed to `f`, oldest
+     * first, until `f` returns false.  The head is read once, so messages
+     * pushed after this starts are left for the next call, and a producer
+     * that keeps pushing cannot hold the consumer here.  While `f` handles
+     * a message, the next one is prefetched, so that walking a long chain
+     * does not wait on a cache miss for every message.
+     *
+     * As with `pop`, the most recent message stays in the queue as its
+     * tail until another message is pushed after it.
+     */
+    template<typename F>
+    void dequeue(F f)
+    {
+      invariant();
+      T* hd = head.load(std::memory_order_relaxed);
+      T* curr = tail;
+
+      while (curr != hd)
+      {
+        T* next = curr->next.load(std::memory_order_relaxed);
+
+        // A producer has swung the head but not yet linked its message.
+        if (next == nullptr)
+          break;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        bits::prefetch(next);
+
+        bool more = f(curr);
+        curr = next;
+
+        if (!more)
+          break;
+      }
+
+      tail = curr;
+      invariant();
+    }
+
     T* peek()
     {
       return tail->next.load(std::memory_order_relaxed);
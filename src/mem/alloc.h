@@ -13,9 +13,11 @@
 
 #include "../test/histogram.h"
 #include "allocstats.h"
+#include "arenaslab.h"
 #include "largealloc.h"
 #include "mediumslab.h"
 #include "pagemap.h"
+#include "profile.h"
 #include "remoteallocator.h"
 #include "sizeclasstable.h"
 #include "slab.h"
@@ -35,7 +37,8 @@ namespace snmalloc
   {
     PMNotOurs = 0,
     PMSuperslab = 1,
-    PMMediumslab = 2
+    PMMediumslab = 2,
+    PMArenaslab = 3
   };
 
 #ifndef SNMALLOC_MAX_FLATPAGEMAP_SIZE
@@ -105,15 +108,7 @@ namespace snmalloc
     {
       size_t size_bits = bits::next_pow2_bits(size);
       set(p, (uint8_t)size_bits);
-      // Set redirect slide
-      uintptr_t ss = (uintptr_t)((size_t)p + SUPERSLAB_SIZE);
-      for (size_t i = 0; i < size_bits - SUPERSLAB_BITS; i++)
-      {
-        size_t run = 1ULL << i;
-        global_pagemap.set_range(
-          (void*)ss, (uint8_t)(64 + i + SUPERSLAB_BITS), run);
-        ss = (uintptr_t)ss + SUPERSLAB_SIZE * run;
-      }
+      set_redirects(p, size_bits);
       global_pagemap.set(p, (uint8_t)size_bits);
     }
     /**
@@ -127,8 +122,43 @@ namespace snmalloc
       auto count = rounded_size >> SUPERSLAB_BITS;
       global_pagemap.set_range((void*)p, PMNotOurs, count);
     }
+    /**
+     * Add pagemap entries indicating that an arena is allocating from a chunk
+     * of `size` bytes.  Chunks larger than a superslab use the same redirect
+     * entries as large allocations.
+     */
+    void set_arena(Arenaslab* slab, size_t size)
+    {
+      set(slab, (uint8_t)PMArenaslab);
+      set_redirects(slab, bits::next_pow2_bits(size));
+    }
+    /**
+     * Remove the entries corresponding to an arena chunk of `size` bytes.
+     */
+    void clear_arena(Arenaslab* slab, size_t size)
+    {
+      assert(get(slab) == PMArenaslab);
+      auto count = bits::next_pow2(size) >> SUPERSLAB_BITS;
+      global_pagemap.set_range((void*)slab, PMNotOurs, count);
+    }
 
   private:
+    /**
+     * Set the entries after the first superslab of a block of `1 << size_bits`
+     * bytes to redirect to the start of the block.
+     */
+    void set_redirects(void* p, size_t size_bits)
+    {
+      uintptr_t ss = (uintptr_t)((size_t)p + SUPERSLAB_SIZE);
+      for (size_t i = 0; i < size_bits - SUPERSLAB_BITS; i++)
+      {
+        size_t run = 1ULL << i;
+        global_pagemap.set_range(
+          (void*)ss, (uint8_t)(64 + i + SUPERSLAB_BITS), run);
+        ss = (uintptr_t)ss + SUPERSLAB_SIZE * run;
+      }
+    }
+
     /**
      * Helper function to set a pagemap entry.  This is not part of the public
      * interface and exists to make it easy to reuse the code in the public
@@ -148,6 +178,8 @@ namespace snmalloc
 #  define SNMALLOC_DEFAULT_PAGEMAP snmalloc::SuperslabMap
 #endif
 
+  class Heap;
+
   /**
    * Allocator.  This class is parameterised on three template parameters.  The
    * `MemoryProvider` defines the source of memory for this allocator.
@@ -182,6 +214,7 @@ namespace snmalloc
 
     template<class MP>
     friend class AllocPool;
+    friend class Heap;
 
     template<
       size_t size,
@@ -201,6 +234,9 @@ namespace snmalloc
 #else
       constexpr uint8_t sizeclass = size_to_sizeclass_const(size);
 
+      if (profiling.load(std::memory_order_relaxed))
+        return profile_alloc<zero_mem, allow_reserve>(size);
+
       stats().alloc_request(size);
 
       handle_message_queue();
@@ -235,6 +271,17 @@ namespace snmalloc
       else
         return calloc(1, size);
 #else
+      if (profiling.load(std::memory_order_relaxed))
+        return profile_alloc<zero_mem, allow_reserve>(size);
+
+      return alloc_unprofiled<zero_mem, allow_reserve>(size);
+#endif
+    }
+
+  private:
+    template<ZeroMem zero_mem, AllowReserve allow_reserve>
+    ALWAYSINLINE void* alloc_unprofiled(size_t size)
+    {
       stats().alloc_request(size);
 
       handle_message_queue();
@@ -258,9 +305,9 @@ namespace snmalloc
       {
         return large_alloc<zero_mem, allow_reserve>(size);
       }
-#endif
     }
 
+  public:
     template<size_t size>
     void dealloc(void* p)
     {
@@ -271,6 +318,10 @@ namespace snmalloc
 
       constexpr uint8_t sizeclass = size_to_sizeclass_const(size);
 
+      if (profiling.load(std::memory_order_relaxed))
+        profile_dealloc(p);
+
+      check_not_arena(p);
       handle_message_queue();
 
       // Free memory of a statically known size. Must be called with an
@@ -308,6 +359,10 @@ namespace snmalloc
       UNUSED(size);
       return free(p);
 #else
+      if (profiling.load(std::memory_order_relaxed))
+        profile_dealloc(p);
+
+      check_not_arena(p);
       handle_message_queue();
 
       // Free memory of a dynamically known size. Must be called with an
@@ -346,6 +401,9 @@ namespace snmalloc
 #ifdef USE_MALLOC
       return free(p);
 #else
+      if (profiling.load(std::memory_order_relaxed))
+        profile_dealloc(p);
+
       handle_message_queue();
 
       // Free memory of an unknown size. Must be called with an external
@@ -391,6 +449,10 @@ namespace snmalloc
           remote_dealloc(target, p, sizeclass);
         return;
       }
+      else if (size == PMArenaslab)
+      {
+        error("Deallocating memory owned by an arena");
+      }
 
 #  ifndef SNMALLOC_SAFE_CLIENT
       if (size > 64 || (void*)super != p)
@@ -441,6 +503,19 @@ namespace snmalloc
         size = global_pagemap.get((void*)ss);
       }
 
+      if (size == PMArenaslab)
+      {
+        Arenaslab* slab = (Arenaslab*)ss;
+        void* start = slab->object_start(p);
+
+        if (start == nullptr)
+          return location == End ? (void*)-1 : nullptr;
+        else if (location == Start)
+          return start;
+        else
+          return (void*)((size_t)start + slab->object_size(start) - 1);
+      }
+
       if (size == 0)
       {
         if (location == End)
@@ -488,6 +563,10 @@ namespace snmalloc
 
         return sizeclass_to_size(slab->get_sizeclass());
       }
+      else if (size == PMArenaslab)
+      {
+        return Arenaslab::get(p)->object_size(p);
+      }
 
       return 1ULL << size;
     }
@@ -497,6 +576,31 @@ namespace snmalloc
       return id();
     }
 
+    /**
+     * Send every cached remote free to its owner, and handle the frees that
+     * other threads have sent to this allocator.  Otherwise, a thread that
+     * stops allocating can hold on to memory that other threads own.  This
+     * is for threads that are about to go idle, for example an event loop
+     * with nothing to do.
+     */
+    void flush()
+    {
+      handle_message_queue();
+
+      // The newest message is only handled once another is pushed after it,
+      // so push the stub message, unless it is already the newest.
+      if (message_queue().is_empty() && (message_queue().get_head() != &stub))
+      {
+        message_queue().push(&stub);
+        handle_message_queue();
+      }
+
+      handle_slab_remotes();
+
+      if (remote.count > 0)
+        post_remote();
+    }
+
   private:
     using alloc_id_t = typename Remote::alloc_id_t;
 
@@ -505,6 +609,11 @@ namespace snmalloc
       Remote head;
       Remote* last;
 
+      // The last object added for a few recently seen slabs.  Objects from
+      // the same slab are linked in after it, so that the owner receives
+      // them one after another and can free them together.
+      Remote* run[REMOTE_RUNS];
+
       RemoteList()
       {
         clear();
@@ -513,83 +622,143 @@ namespace snmalloc
       void clear()
       {
         last = &head;
+
+        for (size_t i = 0; i < REMOTE_RUNS; i++)
+          run[i] = nullptr;
       }
 
       bool empty()
       {
         return last == &head;
       }
+
+      void add(Remote* r)
+      {
+        Slab* slab = Slab::get(r);
+        Remote** l = &run[((size_t)slab >> SLAB_BITS) & REMOTE_RUN_MASK];
+
+        if ((*l != nullptr) && (Slab::get(*l) == slab))
+        {
+          // Insert after the last object from this slab.
+          r->non_atomic_next = (*l)->non_atomic_next;
+          (*l)->non_atomic_next = r;
+
+          if (last == *l)
+            last = r;
+        }
+        else
+        {
+          last->non_atomic_next = r;
+          last = r;
+        }
+
+        *l = r;
+      }
     };
 
     struct RemoteCache
     {
       size_t size = 0;
+      size_t count = 0;
+
+      // When the oldest object in the cache was added.
+      uint64_t first_tick = 0;
+
+      // A bit for each list that is not empty.
+      uint64_t occupied = 0;
+
       RemoteList list[REMOTE_SLOTS];
 
+      static_assert(
+        REMOTE_SLOTS <= sizeof(occupied) * 8,
+        "Need a bit of the occupancy mask for each remote slot");
+
+      /**
+       * The slot for an allocator id in the round of posting where the id
+       * has been shifted by `shift`.  Ids are the addresses of cache-line
+       * aligned queues, so their low bits are all the same, and their other
+       * bits are shared by allocators allocated close together.  Hashing
+       * spreads them over the slots in every round.  The hash is a
+       * bijection, so two ids differ in the slot of some round.
+       */
+      static size_t slot(alloc_id_t id, size_t shift)
+      {
+        return (bits::hash((void*)id) >> shift) & REMOTE_MASK;
+      }
+
+      void insert(size_t i, Remote* r)
+      {
+        RemoteList* l = &list[i];
+        l->last->non_atomic_next = r;
+        l->last = r;
+        occupied |= (uint64_t)1 << i;
+      }
+
       void dealloc(alloc_id_t target_id, void* p, uint8_t sizeclass)
       {
         this->size += sizeclass_to_size(sizeclass);
 
+        if (count++ == 0)
+          first_tick = bits::tick();
+
         Remote* r = (Remote*)p;
         r->set_sizeclass_and_target_id(target_id, sizeclass);
         assert(r->sizeclass() == sizeclass);
         assert(r->target_id() == target_id);
 
-        RemoteList* l = &list[target_id & REMOTE_MASK];
-        l->last->non_atomic_next = r;
-        l->last = r;
+        size_t i = slot(target_id, 0);
+        list[i].add(r);
+        occupied |= (uint64_t)1 << i;
       }
 
       void post(alloc_id_t id)
       {
         // When the cache gets big, post lists to their target allocators.
         size = 0;
+        count = 0;
 
         size_t shift = 0;
 
         while (true)
         {
-          auto my_slot = (id >> shift) & REMOTE_MASK;
+          size_t my_slot = slot(id, shift);
+          uint64_t my_bit = (uint64_t)1 << my_slot;
+          uint64_t send = occupied & ~my_bit;
+          occupied &= my_bit;
 
-          for (size_t i = 0; i < REMOTE_SLOTS; i++)
+          while (send != 0)
           {
-            if (i == my_slot)
-              continue;
+            size_t i = bits::ctz64(send);
+            send &= send - 1;
 
+            // Send all slots to the target at the head of the list.
             RemoteList* l = &list[i];
             Remote* first = l->head.non_atomic_next;
-
-            if (!l->empty())
-            {
-              // Send all slots to the target at the head of the list.
-              Superslab* super = Superslab::get(first);
-              super->get_allocator()->message_queue.push(first, l->last);
-              l->clear();
-            }
+            Superslab* super = Superslab::get(first);
+            super->get_allocator()->message_queue.push(first, l->last);
+            l->clear();
           }
 
-          RemoteList* resend = &list[my_slot];
-          if (resend->empty())
+          if (occupied == 0)
             break;
 
           // Entries could map back onto the "resend" list,
           // so take copy of the head, mark the last element,
           // and clear the original list.
+          RemoteList* resend = &list[my_slot];
           Remote* r = resend->head.non_atomic_next;
           resend->last->non_atomic_next = nullptr;
           resend->clear();
+          occupied = 0;
 
           shift += REMOTE_SLOT_BITS;
+          assert(shift < bits::BITS);
 
           while (r != nullptr)
           {
             // Use the next N bits to spread out remote deallocs in our own
             // slot.
-            size_t slot = (r->target_id() >> shift) & REMOTE_MASK;
-            RemoteList* l = &list[slot];
-            l->last->non_atomic_next = r;
-            l->last = r;
-
+            insert(slot(r->target_id(), shift), r);
             r = r->non_atomic_next;
           }
         }
@@ -605,6 +774,23 @@ namespace snmalloc
     RemoteCache remote;
     Remote stub;
 
+    // Remote frees to handle on the next visit to the message queue, if
+    // more than the configured batch.  Grows while a burst is arriving.
+    size_t remote_budget = 0;
+
+    // Whether allocations are sampled for the heap profile and frees checked
+    // against it.  This is the only profiling state that the fast paths
+    // read.  It is set when sampling is enabled, and cleared by the
+    // allocator itself once sampling is off and no sample is live.
+    std::atomic<bool> profiling{false};
+
+    // Bytes left to allocate before the next heap profile sample.  Sampling
+    // only starts once an allocator has seen a non-zero interval, so the
+    // first countdown is not biased towards the allocation that found it.
+    size_t profile_countdown = 0;
+    bool profile_armed = false;
+    uint64_t profile_rng = 0;
+
     std::conditional_t<IsQueueInline, RemoteAllocator, RemoteAllocator*>
       remote_alloc;
 
@@ -653,6 +839,7 @@ namespace snmalloc
 
       init_message_queue();
       message_queue().invariant();
+      update_profiling();
 
 #ifndef NDEBUG
       for (uint8_t i = 0; i < NUM_SIZECLASSES; i++)
@@ -688,6 +875,100 @@ namespace snmalloc
       return (void*)(end_point_correction - end_to_end);
     }
 
+    template<ZeroMem zero_mem, AllowReserve allow_reserve>
+    NOINLINE void* profile_alloc(size_t size)
+    {
+      void* p = alloc_unprofiled<zero_mem, allow_reserve>(size);
+
+      if (size < profile_countdown)
+      {
+        profile_countdown -= size;
+        return p;
+      }
+
+      size_t interval =
+        runtime_config.profile_interval.load(std::memory_order_relaxed);
+
+      if (interval == 0)
+      {
+        profile_armed = false;
+        profile_countdown = PROFILE_RECHECK;
+        stop_profiling();
+        return p;
+      }
+
+      if (!profile_armed)
+      {
+        profile_armed = true;
+        profile_rng = (bits::tick() ^ (uint64_t)(size_t)this) | 1;
+      }
+      else if (p != nullptr)
+      {
+        // Omit this frame from the stack.
+        void* stack[PROFILE_MAX_DEPTH];
+        size_t depth = HeapProfile::backtrace(stack, 1);
+        heap_profile.record(p, size, stack, depth);
+      }
+
+      profile_countdown = HeapProfile::next_interval(profile_rng, interval);
+      return p;
+    }
+
+    /**
+     * Objects in an arena are only released with the arena.  The sized
+     * deallocation paths do not otherwise read the pagemap, so they only
+     * check for this in debug builds.
+     */
+    void check_not_arena(void* p)
+    {
+#ifndef NDEBUG
+      if (pagemap().get(p) == PMArenaslab)
+        error("Deallocating memory owned by an arena");
+#else
+      UNUSED(p);
+#endif
+    }
+
+    NOINLINE void profile_dealloc(void* p)
+    {
+      if (heap_profile.maybe_sampled(p))
+        heap_profile.forget(p);
+      else if (
+        runtime_config.profile_interval.load(std::memory_order_relaxed) == 0)
+        stop_profiling();
+    }
+
+    /**
+     * Turn profiling on for this allocator if sampling is enabled or any
+     * sample is live.  Called when the allocator is created or handed out,
+     * and when sampling is enabled.
+     */
+    void update_profiling()
+    {
+      // Order this against the store that enabled sampling, or against the
+      // store that published this allocator, whichever came second.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      if (
+        (runtime_config.profile_interval.load(std::memory_order_relaxed) !=
+         0) ||
+        heap_profile.has_samples())
+        profiling.store(true, std::memory_order_relaxed);
+    }
+
+    /**
+     * Turn profiling off for this allocator once no sample is live, looking
+     * again afterwards in case sampling was enabled meanwhile.
+     */
+    void stop_profiling()
+    {
+      if (heap_profile.has_samples())
+        return;
+
+      profiling.store(false, std::memory_order_relaxed);
+      update_profiling();
+    }
+
     void init_message_queue()
     {
       message_queue().init(&stub);
@@ -716,24 +997,123 @@ namespace snmalloc
       }
     }
 
-    NOINLINE void handle_message_queue_inner()
+    /**
+     * Frees of small objects in one slab, received one after another, to be
+     * handed to the slab together.  The objects are linked through their
+     * first two bytes, from the index `head` to `last`.
+     */
+    struct SlabRun
     {
-      for (size_t i = 0; i < REMOTE_BATCH; i++)
+      Slab* slab = nullptr;
+      void* last = nullptr;
+      uint16_t head = 0;
+      uint16_t count = 0;
+      uint8_t sizeclass = 0;
+    };
+
+    void handle_dealloc_remote(Remote* p, SlabRun& run)
+    {
+      if ((p == &stub) || (p->target_id() != id()))
       {
-        std::pair<Remote*, Remote*> r = message_queue().pop();
+        handle_dealloc_remote(p);
+        return;
+      }
 
-        if (std::get<0>(r) == nullptr)
-          break;
+      uint8_t sizeclass = p->sizeclass();
 
-        handle_dealloc_remote(std::get<1>(r));
+      if (sizeclass >= NUM_SMALL_CLASSES)
+      {
+        handle_dealloc_remote(p);
+        return;
       }
 
-      // Our remote queues may be larger due to forwarding remote frees.
-      if (remote.size < REMOTE_CACHE)
+      Slab* slab = Slab::get(p);
+
+#ifndef SNMALLOC_SAFE_CLIENT
+      if (!is_multiple_of_sizeclass(
+            sizeclass_to_size(sizeclass),
+            (uintptr_t)slab + SLAB_SIZE - (uintptr_t)p))
+      {
+        error("Not deallocating start of an object");
+      }
+#endif
+
+      stats().remote_receive(sizeclass);
+
+      if (slab != run.slab)
+      {
+        small_dealloc_run(run);
+        run.slab = slab;
+        run.last = p;
+        run.sizeclass = sizeclass;
+      }
+      else
+      {
+        *(uint16_t*)p = run.head;
+      }
+
+      run.head = (uint16_t)((size_t)p - (size_t)slab);
+      run.count++;
+    }
+
+    void small_dealloc_run(SlabRun& run)
+    {
+      if (run.count == 0)
         return;
 
-      stats().remote_post();
-      remote.post(id());
+      if (
+        (run.count > 1) &&
+        run.slab->dealloc_run(run.head, run.last, run.count))
+      {
+        for (uint16_t n = 0; n < run.count; n++)
+          stats().sizeclass_dealloc(run.sizeclass);
+      }
+      else
+      {
+        uint16_t index = run.head;
+
+        for (uint16_t n = 0; n < run.count; n++)
+        {
+          void* p = (void*)((size_t)run.slab + index);
+          index = *(uint16_t*)p;
+          small_dealloc(Superslab::get(p), p, run.sizeclass);
+        }
+      }
+
+      run.count = 0;
+    }
+
+    NOINLINE void handle_message_queue_inner()
+    {
+      size_t batch =
+        runtime_config.remote_batch.load(std::memory_order_relaxed);
+      size_t budget = (std::max)(batch, remote_budget);
+      size_t handled = 0;
+      SlabRun run;
+
+      message_queue().dequeue([&](Remote* r) {
+        handle_dealloc_remote(r, run);
+        return ++handled < budget;
+      });
+
+      small_dealloc_run(run);
+
+      // If the batch was used up, a burst is probably arriving, so take a
+      // bigger batch next time.  This drains a burst in a number of calls
+      // that grows with the log of its size, rather than linearly.
+      if (handled == budget)
+      {
+        size_t limit = (std::max)(batch, REMOTE_BATCH_MAX);
+        remote_budget = (std::min)(budget * 2, limit);
+      }
+      else
+      {
+        remote_budget = 0;
+      }
+
+      // Our remote queues may be larger due to forwarding remote frees.
+      if (remote_due<true>())
+        post_remote();
     }
 
     inline void handle_message_queue()
@@ -802,6 +1182,9 @@ namespace snmalloc
     template<AllowReserve allow_reserve>
     Slab* alloc_slab(uint8_t sizeclass)
     {
+      if (remote_due<true>())
+        post_remote();
+
       stats().sizeclass_alloc_slab(sizeclass);
       if (Superslab::is_short_sizeclass(sizeclass))
       {
@@ -870,7 +1253,73 @@ namespace snmalloc
         sc->insert(slab->get_link());
       }
 
-      return slab->alloc<zero_mem>(sc, rsize, large_allocator.memory_provider);
+      void* p =
+        slab->alloc<zero_mem>(sc, rsize, large_allocator.memory_provider);
+
+#ifdef USE_SLAB_REMOTE_FREE
+      Metaslab* meta = slab->get_meta();
+
+      if (meta->is_full())
+        take_slab_remote(slab, meta, sizeclass);
+#endif
+
+      return p;
+    }
+
+#ifdef USE_SLAB_REMOTE_FREE
+    /**
+     * A slab has just become full.  Objects that other threads have freed in
+     * it become its free list, and it goes back on its sizeclass list.
+     */
+    void take_slab_remote(Slab* slab, Metaslab* meta, uint8_t sizeclass)
+    {
+      uint16_t count = meta->take_remote();
+
+      if (count == 0)
+        return;
+
+      small_classes[sizeclass].insert(meta->get_link(slab));
+      meta->debug_slab_invariant(slab->is_short(), slab);
+
+      for (uint16_t i = 0; i < count; i++)
+      {
+        stats().remote_receive(sizeclass);
+        stats().sizeclass_dealloc(sizeclass);
+      }
+    }
+#endif
+
+    /**
+     * Free the objects that other threads have pushed on the remote free
+     * lists of slabs that are not full.  These are otherwise only taken when
+     * a slab fills up, so this is needed before an allocator can be empty.
+     */
+    void handle_slab_remotes()
+    {
+#ifdef USE_SLAB_REMOTE_FREE
+      for (uint8_t i = 0; i < NUM_SMALL_CLASSES; i++)
+      {
+        SlabLink* link = small_classes[i].get_head();
+
+        while (link != (SlabLink*)~0)
+        {
+          // Freeing may return the slab, so move on before freeing.
+          Slab* slab = link->get_slab();
+          link = link->next;
+
+          uint16_t count;
+          uint16_t index = slab->get_meta()->take_remote_all(count);
+
+          for (uint16_t n = 0; n < count; n++)
+          {
+            void* p = (void*)((size_t)slab + index);
+            index = *(uint16_t*)p;
+            stats().remote_receive(i);
+            small_dealloc(Superslab::get(p), p, i);
+          }
+        }
+      }
+#endif
     }
 
     void small_dealloc(Superslab* super, void* p, uint8_t sizeclass)
@@ -923,7 +1372,7 @@ namespace snmalloc
         {
           super_available.remove(super);
 
-          if (decommit_strategy == DecommitSuper)
+          if (chunk_decommit_strategy == DecommitSuper)
           {
             large_allocator.memory_provider.notify_not_using(
               (void*)((size_t)super + OS_PAGE_SIZE),
@@ -964,6 +1413,9 @@ namespace snmalloc
       }
       else
       {
+        if (remote_due<true>())
+          post_remote();
+
         slab =
           (Mediumslab*)large_allocator.template alloc<NoZero, allow_reserve>(
             0, SUPERSLAB_SIZE);
@@ -1007,7 +1459,7 @@ namespace snmalloc
           sc->remove(slab);
         }
 
-        if (decommit_strategy == DecommitSuper)
+        if (chunk_decommit_strategy == DecommitSuper)
         {
           large_allocator.memory_provider.notify_not_using(
             (void*)((size_t)slab + OS_PAGE_SIZE),
@@ -1037,6 +1489,9 @@ namespace snmalloc
           zero_mem == YesZero ? "zeromem" : "nozeromem",
           allow_reserve == NoReserve ? "noreserve" : "reserve"));
 
+      if (remote_due<true>())
+        post_remote();
+
       size_t size_bits = bits::next_pow2_bits(size);
       size_t large_class = size_bits - SUPERSLAB_BITS;
       assert(large_class < NUM_LARGE_CLASSES);
@@ -1063,7 +1518,7 @@ namespace snmalloc
 
       stats().large_dealloc(large_class);
 
-      if ((decommit_strategy != DecommitNone) || (large_class > 0))
+      if ((chunk_decommit_strategy != DecommitNone) || (large_class > 0))
         large_allocator.memory_provider.notify_not_using(
           (void*)((size_t)p + OS_PAGE_SIZE), rsize - OS_PAGE_SIZE);
 
@@ -1077,12 +1532,59 @@ namespace snmalloc
     {
       MEASURE_TIME(remote_dealloc, 4, 16);
 
+#ifdef USE_SLAB_REMOTE_FREE
+      if (sizeclass < NUM_SMALL_CLASSES)
+      {
+        Slab* slab = Slab::get(p);
+
+        if (slab->get_meta()->remote_push(slab, p))
+        {
+          stats().remote_free_direct(sizeclass);
+          return;
+        }
+      }
+#endif
+
       stats().remote_free(sizeclass);
       remote.dealloc(target->id(), p, sizeclass);
 
-      if (remote.size < REMOTE_CACHE)
-        return;
+      if (remote_due<false>())
+        post_remote();
+    }
+
+    /**
+     * Whether to send the remote cache to its owners: when it holds
+     * `remote_cache` bytes or `remote_cache_objects` objects, or, if
+     * `check_age` is set, its oldest object was added `remote_cache_ticks`
+     * ticks ago.  Reading the clock is not free, so the age is only checked
+     * on slow paths.
+     */
+    template<bool check_age>
+    bool remote_due()
+    {
+      if (remote.count == 0)
+        return false;
+
+      auto& c = runtime_config;
+      size_t bytes = c.remote_cache.load(std::memory_order_relaxed);
+      size_t objects = c.remote_cache_objects.load(std::memory_order_relaxed);
 
+      if ((remote.size >= bytes) || (remote.count >= objects))
+        return true;
+
+      if constexpr (check_age)
+      {
+        size_t ticks = c.remote_cache_ticks.load(std::memory_order_relaxed);
+        return (ticks != 0) && (bits::tick() - remote.first_tick >= ticks);
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    void post_remote()
+    {
       stats().remote_post();
       remote.post(id());
     }
@@ -30,15 +30,45 @@ namespace snmalloc
 #endif
     ;
 
+  // Return remote allocs when the local cache holds this many objects.
+  static constexpr size_t REMOTE_CACHE_OBJECTS =
+#ifdef USE_REMOTE_CACHE_OBJECTS
+    USE_REMOTE_CACHE_OBJECTS
+#else
+    1 << 14
+#endif
+    ;
+
+  // Return remote allocs once the oldest in the local cache has been there
+  // for this many ticks of the cycle counter.  This is checked on slow paths
+  // only.  Zero disables the check.
+  static constexpr size_t REMOTE_CACHE_TICKS =
+#ifdef USE_REMOTE_CACHE_TICKS
+    USE_REMOTE_CACHE_TICKS
+#else
+    1 << 30
+#endif
+    ;
+
   // Handle at most this many object from the remote dealloc queue at a time.
   static constexpr size_t REMOTE_BATCH =
 #ifdef USE_REMOTE_BATCH
-    REMOTE_BATCH
+    USE_REMOTE_BATCH
 #else
     64
 #endif
     ;
 
+  // While a burst of remote frees is arriving, the batch doubles each time
+  // it is used up, to at most this many objects.
+  static constexpr size_t REMOTE_BATCH_MAX =
+#ifdef USE_REMOTE_BATCH_MAX
+    USE_REMOTE_BATCH_MAX
+#else
+    1 << 16
+#endif
+    ;
+
   static constexpr size_t RESERVE_MULTIPLE =
 #ifdef USE_RESERVE_MULTIPLE
     USE_RESERVE_MULTIPLE
@@ -47,6 +77,14 @@ namespace snmalloc
 #endif
     ;
 
+  static constexpr size_t PROFILE_INTERVAL =
+#ifdef USE_PROFILE_INTERVAL
+    USE_PROFILE_INTERVAL
+#else
+    0
+#endif
+    ;
+
   enum DecommitStrategy
   {
     DecommitNone,
@@ -62,6 +100,70 @@ namespace snmalloc
 #endif
     ;
 
+  /**
+   * The decommit strategy for superslab-sized chunks, read only on the slow
+   * paths that return chunks to the large allocator and reuse them.  This
+   * starts as `decommit_strategy` and may be changed from the environment
+   * when the first allocator is created, but never after that: chunks that
+   * have been returned for reuse are in the state that the strategy
+   * expects.  Decommitting single slabs is decided at compile time, so
+   * `DecommitAll` can neither be chosen nor replaced here.
+   */
+  HEADER_GLOBAL DecommitStrategy chunk_decommit_strategy = decommit_strategy;
+
+  enum HugePages
+  {
+    // Leave the platform default for transparent huge pages.
+    HugePagesDefault,
+    HugePagesAlways,
+    HugePagesNever
+  };
+
+  /**
+   * The tunables that are safe to change while the allocator is running.
+   * These start with the compile-time values above, and can be changed
+   * from the environment at startup or through `mallctl`.
+   */
+  struct RuntimeConfig
+  {
+    // Return remote small allocs when the local cache reaches this size.
+    std::atomic<size_t> remote_cache{REMOTE_CACHE};
+
+    // Return remote allocs when the local cache holds this many objects.
+    // Must not be zero.
+    std::atomic<size_t> remote_cache_objects{REMOTE_CACHE_OBJECTS};
+
+    // Return remote allocs once the oldest in the local cache is this many
+    // ticks old, checked on slow paths.  Zero disables the check.
+    std::atomic<size_t> remote_cache_ticks{REMOTE_CACHE_TICKS};
+
+    // Handle at most this many objects from the remote dealloc queue at a
+    // time.  Must not be zero.
+    std::atomic<size_t> remote_batch{REMOTE_BATCH};
+
+    // Reserve address space from the platform in multiples of this many
+    // superslabs.  Must not be zero.
+    std::atomic<size_t> reserve_multiple{RESERVE_MULTIPLE};
+
+    // Sample an allocation for the heap profile once per this many bytes on
+    // average.  Zero disables sampling.
+    std::atomic<size_t> profile_interval{PROFILE_INTERVAL};
+
+    // Whether to ask for transparent huge pages in newly reserved memory.
+    std::atomic<HugePages> huge_pages{HugePagesDefault};
+
+    // If set, the malloc shim writes a statistics report to this file when
+    // the process exits.
+    std::atomic<const char*> stats_file{nullptr};
+
+    // If set, the malloc shim records up to `trace_events` allocation events
+    // to this file.
+    std::atomic<const char*> trace_file{nullptr};
+    std::atomic<size_t> trace_events{1 << 22};
+  };
+
+  HEADER_GLOBAL RuntimeConfig runtime_config;
+
   // The remaining values are derived, not configurable.
 
   // Used to isolate values on cache lines to prevent false sharing.
@@ -104,6 +206,11 @@ namespace snmalloc
   static constexpr size_t REMOTE_SLOTS = 1 << REMOTE_SLOT_BITS;
   static constexpr size_t REMOTE_MASK = REMOTE_SLOTS - 1;
 
+  // Number of slabs per remote slot whose objects are kept together.
+  static constexpr size_t REMOTE_RUN_BITS = 2;
+  static constexpr size_t REMOTE_RUNS = 1 << REMOTE_RUN_BITS;
+  static constexpr size_t REMOTE_RUN_MASK = REMOTE_RUNS - 1;
+
   static_assert(
     INTERMEDIATE_BITS < MIN_ALLOC_BITS,
     "INTERMEDIATE_BITS must be less than MIN_ALLOC_BITS");
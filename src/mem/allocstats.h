@@ -111,6 +111,41 @@ namespace snmalloc
 #endif
     };
 
+    /**
+     * Counters for a single sizeclass that are maintained in every build.
+     * They are plain integers, written only by the owning allocator, so they
+     * cost one increment on each path that updates them.
+     */
+    struct Counters
+    {
+      size_t allocs = 0;
+      size_t frees = 0;
+      size_t slabs = 0;
+
+      void add(Counters& that)
+      {
+        allocs += that.allocs;
+        frees += that.frees;
+        slabs += that.slabs;
+      }
+    };
+
+    Counters sizeclass_counters[N];
+    Counters large_counters[LARGE_N];
+
+    // Objects sent to, and received from, other allocators.
+    size_t remote_frees = 0;
+    size_t remote_receives = 0;
+
+    // Address space reserved from the platform, and the part of it that is
+    // held as superslabs, medium slabs and large objects.  Pages decommitted
+    // inside a superslab are not subtracted, so `committed` is an upper bound.
+    // A chunk is released by whichever allocator frees its last object, not
+    // necessarily the one that took it, so `committed` for one allocator can
+    // be negative; only the sum over all allocators is meaningful.
+    size_t reserved = 0;
+    ptrdiff_t committed = 0;
+
 #ifdef USE_SNMALLOC_STATS
     static constexpr size_t BUCKETS_BITS = 4;
     static constexpr size_t BUCKETS = 1 << BUCKETS_BITS;
@@ -163,7 +198,7 @@ namespace snmalloc
 
     void sizeclass_alloc(uint8_t sc)
     {
-      UNUSED(sc);
+      sizeclass_counters[sc].allocs++;
 
 #ifdef USE_SNMALLOC_STATS
       sizeclass[sc].addToRunningAverage();
@@ -173,7 +208,7 @@ namespace snmalloc
 
     void sizeclass_dealloc(uint8_t sc)
     {
-      UNUSED(sc);
+      sizeclass_counters[sc].frees++;
 
 #ifdef USE_SNMALLOC_STATS
       sizeclass[sc].addToRunningAverage();
@@ -183,7 +218,7 @@ namespace snmalloc
 
     void large_alloc(size_t sc)
     {
-      UNUSED(sc);
+      large_counters[sc].allocs++;
 
 #ifdef USE_SNMALLOC_STATS
       large[sc].count.inc();
@@ -192,7 +227,7 @@ namespace snmalloc
 
     void sizeclass_alloc_slab(uint8_t sc)
     {
-      UNUSED(sc);
+      sizeclass_counters[sc].slabs++;
 
 #ifdef USE_SNMALLOC_STATS
       sizeclass[sc].addToRunningAverage();
@@ -202,7 +237,7 @@ namespace snmalloc
 
     void sizeclass_dealloc_slab(uint8_t sc)
     {
-      UNUSED(sc);
+      sizeclass_counters[sc].slabs--;
 
 #ifdef USE_SNMALLOC_STATS
       sizeclass[sc].addToRunningAverage();
@@ -212,20 +247,40 @@ namespace snmalloc
 
     void large_dealloc(size_t sc)
     {
-      UNUSED(sc);
+      large_counters[sc].frees++;
 
 #ifdef USE_SNMALLOC_STATS
       large[sc].count.dec();
 #endif
     }
 
-    void segment_create()
+    void segment_create(size_t size)
     {
+      reserved += size;
+
 #ifdef USE_SNMALLOC_STATS
       segment_count++;
 #endif
     }
 
+    void chunk_alloc(size_t size)
+    {
+      committed += (ptrdiff_t)size;
+    }
+
+    void chunk_dealloc(size_t size)
+    {
+      committed -= (ptrdiff_t)size;
+    }
+
+    /**
+     * Committed bytes, clamped at zero, for reporting a sum of `committed`.
+     */
+    size_t committed_bytes()
+    {
+      return committed < 0 ? 0 : (size_t)committed;
+    }
+
     void superslab_pop()
     {
 #ifdef USE_SNMALLOC_STATS
@@ -250,12 +305,23 @@ namespace snmalloc
     void remote_free(uint8_t sc)
     {
       UNUSED(sc);
+      remote_frees++;
 
 #ifdef USE_SNMALLOC_STATS
       remote_freed += sizeclass_to_size(sc);
 #endif
     }
 
+    void remote_free_direct(uint8_t sc)
+    {
+      // Freed straight to the slab, so there is nothing left to post.
+      remote_free(sc);
+
+#ifdef USE_SNMALLOC_STATS
+      remote_posted += sizeclass_to_size(sc);
+#endif
+    }
+
     void remote_post()
     {
 #ifdef USE_SNMALLOC_STATS
@@ -266,6 +332,7 @@ namespace snmalloc
     void remote_receive(uint8_t sc)
     {
       UNUSED(sc);
+      remote_receives++;
 
 #ifdef USE_SNMALLOC_STATS
       remote_received += sizeclass_to_size(sc);
@@ -274,7 +341,16 @@ namespace snmalloc
 
     void add(AllocStats<N, LARGE_N>& that)
     {
-      UNUSED(that);
+      for (size_t i = 0; i < N; i++)
+        sizeclass_counters[i].add(that.sizeclass_counters[i]);
+
+      for (size_t i = 0; i < LARGE_N; i++)
+        large_counters[i].add(that.large_counters[i]);
+
+      remote_frees += that.remote_frees;
+      remote_receives += that.remote_receives;
+      reserved += that.reserved;
+      committed += that.committed;
 
 #ifdef USE_SNMALLOC_STATS
       for (size_t i = 0; i < N; i++)
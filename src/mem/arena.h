@@ -0,0 +1,175 @@
+#pragma once
+
+#include "alloc.h"
+
+namespace snmalloc
+{
+  /**
+   * Bump allocator for objects that are all discarded at the same time.
+   * Memory is taken from the `MemoryProvider` a superslab at a time and is
+   * registered in the pagemap, so `external_pointer` and `alloc_size` work on
+   * arena objects and freeing one with `dealloc` is reported as an error.
+   *
+   * Objects larger than a chunk get a dedicated chunk of their own.  These
+   * are returned to the memory provider by `reset`, whereas ordinary chunks
+   * are kept for reuse until `release` is called.
+   *
+   * An arena does no locking: callers must ensure that only one thread uses
+   * a given arena at a time.
+   */
+  template<
+    class MemoryProvider = GlobalVirtual,
+    class PageMap = SNMALLOC_DEFAULT_PAGEMAP>
+  class Arena
+  {
+    LargeAlloc<MemoryProvider> large_allocator;
+    PageMap page_map;
+
+    // Chunks in the order in which they are allocated from.  Chunks after
+    // `current` are empty.
+    Arenaslab* first = nullptr;
+    Arenaslab* current = nullptr;
+
+    // Dedicated chunks for objects larger than `Arenaslab::capacity()`.
+    Arenaslab* large = nullptr;
+
+    template<ZeroMem zero_mem>
+    Arenaslab* alloc_chunk(size_t large_class)
+    {
+      size_t rsize = SUPERSLAB_SIZE << large_class;
+
+      Arenaslab* slab = (Arenaslab*)large_allocator.template alloc<zero_mem>(
+        large_class, rsize);
+      slab->init(rsize);
+      page_map.set_arena(slab, rsize);
+      return slab;
+    }
+
+    void dealloc_chunk(Arenaslab* slab)
+    {
+      size_t rsize = slab->get_size();
+      size_t large_class = bits::next_pow2_bits(rsize) - SUPERSLAB_BITS;
+
+      page_map.clear_arena(slab, rsize);
+
+      if ((chunk_decommit_strategy != DecommitNone) || (large_class > 0))
+        large_allocator.memory_provider.notify_not_using(
+          (void*)((size_t)slab + OS_PAGE_SIZE), rsize - OS_PAGE_SIZE);
+
+      // Initialise in order to set the correct SlabKind.
+      Largeslab* l = (Largeslab*)slab;
+      l->init();
+      large_allocator.dealloc(l, large_class);
+    }
+
+    void dealloc_chunks(Arenaslab* slab)
+    {
+      while (slab != nullptr)
+      {
+        Arenaslab* next = slab->get_next();
+        dealloc_chunk(slab);
+        slab = next;
+      }
+    }
+
+    template<ZeroMem zero_mem>
+    NOINLINE void* alloc_large(size_t size)
+    {
+      size_t size_bits =
+        bits::next_pow2_bits(size + Arenaslab::header_size());
+      size_t large_class = size_bits - SUPERSLAB_BITS;
+      assert(large_class < NUM_LARGE_CLASSES);
+
+      Arenaslab* slab = alloc_chunk<zero_mem>(large_class);
+      slab->set_next(large);
+      large = slab;
+
+      return slab->alloc(size);
+    }
+
+    NOINLINE void* alloc_slow(size_t size)
+    {
+      // Move on to a chunk that was kept by `reset`, if there is one.
+      Arenaslab* next = (current == nullptr) ? first : current->get_next();
+
+      if (next == nullptr)
+      {
+        next = alloc_chunk<NoZero>(0);
+
+        if (current == nullptr)
+          first = next;
+        else
+          current->set_next(next);
+      }
+
+      current = next;
+      return current->alloc(size);
+    }
+
+  public:
+    Arena(
+      MemoryProvider& mp = default_memory_provider, PageMap&& p = PageMap())
+    : large_allocator(mp), page_map(p)
+    {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena()
+    {
+      release();
+    }
+
+    template<ZeroMem zero_mem = NoZero>
+    ALLOCATOR void* alloc(size_t size)
+    {
+      // Include size 0 in the first sizeclass.
+      size = bits::align_up(size == 0 ? 1 : size, MIN_ALLOC_SIZE);
+
+      if (size > Arenaslab::capacity())
+        return alloc_large<zero_mem>(size);
+
+      void* p = (current == nullptr) ? nullptr : current->alloc(size);
+
+      if (p == nullptr)
+        p = alloc_slow(size);
+
+      if (zero_mem == YesZero)
+        large_allocator.memory_provider.zero(p, size);
+
+      return p;
+    }
+
+    template<size_t size, ZeroMem zero_mem = NoZero>
+    ALLOCATOR void* alloc()
+    {
+      return alloc<zero_mem>(size);
+    }
+
+    /**
+     * Discard every object allocated from this arena.  Chunks are kept and
+     * allocated from again, apart from dedicated chunks for large objects.
+     */
+    void reset()
+    {
+      for (Arenaslab* slab = first; slab != nullptr; slab = slab->get_next())
+        slab->reset();
+
+      current = first;
+
+      dealloc_chunks(large);
+      large = nullptr;
+    }
+
+    /**
+     * Discard every object allocated from this arena and return all of its
+     * memory to the memory provider.
+     */
+    void release()
+    {
+      dealloc_chunks(first);
+      dealloc_chunks(large);
+      first = current = large = nullptr;
+    }
+  };
+}
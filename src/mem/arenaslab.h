@@ -0,0 +1,192 @@
+#pragma once
+
+#include "../ds/bits.h"
+#include "allocconfig.h"
+#include "baseslab.h"
+
+namespace snmalloc
+{
+  class Arenaslab : public Baseslab
+  {
+    // This is the view of a chunk of memory that an arena is bump allocating
+    // from.  Objects are not freed individually, so the only metadata needed
+    // is a bitmap recording where each object starts, which is used to
+    // answer `external_pointer` and `alloc_size` queries.
+  private:
+    static constexpr size_t START_BITS = SUPERSLAB_SIZE >> MIN_ALLOC_BITS;
+    static constexpr size_t START_WORDS = START_BITS / bits::BITS;
+
+    Arenaslab* next_chunk;
+    size_t top;
+    size_t limit;
+    // Words of `starts` below this index have been cleared since the chunk
+    // was last empty.  Later words are only cleared as the bump pointer
+    // reaches them, so a chunk that is barely used does not touch, and so
+    // commit, the whole bitmap.
+    size_t cleared;
+    size_t starts[START_WORDS];
+
+    size_t index_of(size_t p)
+    {
+      return (p - (size_t)this) >> MIN_ALLOC_BITS;
+    }
+
+    /**
+     * Clear the words of the bitmap that cover addresses below `end`.
+     */
+    void clear_starts(size_t end)
+    {
+      size_t last = index_of(end - 1) / bits::BITS;
+
+      if (last >= START_WORDS)
+        last = START_WORDS - 1;
+
+      while (cleared <= last)
+        starts[cleared++] = 0;
+    }
+
+  public:
+    static constexpr size_t header_size()
+    {
+      // Round up to a page, so that objects are page aligned in dedicated
+      // chunks.
+      return (sizeof(Arenaslab) + OS_PAGE_SIZE - 1) & ~(OS_PAGE_SIZE - 1);
+    }
+
+    /**
+     * The largest object that can be bump allocated from a chunk that is a
+     * single superslab.
+     */
+    static constexpr size_t capacity()
+    {
+      return SUPERSLAB_SIZE - header_size();
+    }
+
+    static Arenaslab* get(void* p)
+    {
+      return (Arenaslab*)((size_t)p & SUPERSLAB_MASK);
+    }
+
+    void init(size_t size)
+    {
+      kind = ArenaChunk;
+      next_chunk = nullptr;
+      top = (size_t)this + header_size();
+      limit = (size_t)this + size;
+      cleared = 0;
+    }
+
+    Arenaslab* get_next()
+    {
+      return next_chunk;
+    }
+
+    void set_next(Arenaslab* next)
+    {
+      next_chunk = next;
+    }
+
+    size_t get_size()
+    {
+      return limit - (size_t)this;
+    }
+
+    bool is_empty()
+    {
+      return top == (size_t)this + header_size();
+    }
+
+    /**
+     * Allocate `size` bytes, which must be a multiple of the minimum
+     * allocation size.  Returns `nullptr` if the chunk is full.
+     */
+    void* alloc(size_t size)
+    {
+      assert(bits::is_aligned_block<MIN_ALLOC_SIZE>(nullptr, size));
+
+      if (size > limit - top)
+        return nullptr;
+
+      size_t p = top;
+      size_t i = index_of(p);
+      clear_starts(p + size);
+      starts[i / bits::BITS] |= (size_t)1 << (i % bits::BITS);
+      top = p + size;
+      return (void*)p;
+    }
+
+    /**
+     * Forget about every object in this chunk.
+     */
+    void reset()
+    {
+      top = (size_t)this + header_size();
+      cleared = 0;
+    }
+
+    /**
+     * Returns the start of the object containing `p`, or `nullptr` if `p`
+     * precedes every object in this chunk.
+     */
+    void* object_start(void* p)
+    {
+      // Only the bitmap below the bump pointer has been cleared, and no
+      // object starts above it.
+      if (is_empty())
+        return nullptr;
+
+      size_t i = index_of(((size_t)p < top) ? (size_t)p : top - 1);
+
+      // Addresses beyond the bitmap are in the single object of a dedicated
+      // chunk.
+      if (i >= START_BITS)
+        i = START_BITS - 1;
+
+      size_t w = i / bits::BITS;
+      size_t word =
+        starts[w] & (~(size_t)0 >> (bits::BITS - 1 - (i % bits::BITS)));
+
+      while (word == 0)
+      {
+        if (w == 0)
+          return nullptr;
+
+        word = starts[--w];
+      }
+
+      size_t start = (w * bits::BITS) + (bits::BITS - 1 - bits::clz(word));
+      return (void*)((size_t)this + (start << MIN_ALLOC_BITS));
+    }
+
+    /**
+     * Returns the size of the object that starts at `p`.
+     */
+    size_t object_size(void* p)
+    {
+      size_t i = index_of((size_t)p) + 1;
+      size_t end = index_of(top);
+
+      if (end > START_BITS)
+        end = START_BITS;
+
+      while (i < end)
+      {
+        size_t word = starts[i / bits::BITS] >> (i % bits::BITS);
+
+        if (word != 0)
+        {
+          size_t next = i + bits::ctz(word);
+
+          if (next < end)
+            return ((size_t)this + (next << MIN_ALLOC_BITS)) - (size_t)p;
+
+          break;
+        }
+
+        i = bits::align_up(i + 1, bits::BITS);
+      }
+
+      return top - (size_t)p;
+    }
+  };
+}
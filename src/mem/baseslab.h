@@ -10,7 +10,8 @@ namespace snmalloc
     Fresh = 0,
     Large,
     Medium,
-    Super
+    Super,
+    ArenaChunk
   };
 
   class Baseslab
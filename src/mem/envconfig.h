@@ -0,0 +1,184 @@
+#pragma once
+
+#include "../ds/fdwriter.h"
+#include "allocconfig.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace snmalloc
+{
+  /**
+   * Reads `SNMALLOC_*` environment variables into the runtime configuration.
+   * This runs once, when the global allocator pool is created, and does not
+   * allocate.  Invalid values are reported on stderr and ignored.
+   *
+   *  - `SNMALLOC_REMOTE_CACHE`: bytes of remote frees to batch up.
+   *  - `SNMALLOC_REMOTE_CACHE_OBJECTS`: remote frees to batch up.
+   *  - `SNMALLOC_REMOTE_CACHE_TICKS`: cycle counter ticks to hold remote
+   *    frees for, or 0 for no limit.
+   *  - `SNMALLOC_REMOTE_BATCH`: remote frees to handle at a time.
+   *  - `SNMALLOC_RESERVE_SIZE`: bytes of address space to reserve at a time,
+   *    rounded down to a whole number of superslabs.
+   *  - `SNMALLOC_DECOMMIT`: `none` or `super`, or `all` only if that is
+   *    the compile-time strategy.
+   *  - `SNMALLOC_THP`: `default`, `always` or `never`, for transparent huge
+   *    pages on Linux.
+   *  - `SNMALLOC_PROFILE_INTERVAL`: bytes between heap profile samples.
+   *  - `SNMALLOC_STATS_FILE`: file to write statistics to at exit.
+   *  - `SNMALLOC_TRACE_FILE`: file to record allocation events to.
+   *  - `SNMALLOC_TRACE_EVENTS`: maximum number of events to record.
+   *
+   * Sizes may have a `k`, `m` or `g` suffix.
+   */
+  class EnvConfig
+  {
+    static bool parse_size(const char* s, size_t& value)
+    {
+      size_t v = 0;
+      size_t digits = 0;
+
+      for (; (*s >= '0') && (*s <= '9'); s++, digits++)
+      {
+        size_t next = (v * 10) + (size_t)(*s - '0');
+
+        if (next / 10 != v)
+          return false;
+
+        v = next;
+      }
+
+      size_t shift = 0;
+
+      switch (*s)
+      {
+        case 'k':
+        case 'K':
+          shift = 10;
+          break;
+        case 'm':
+        case 'M':
+          shift = 20;
+          break;
+        case 'g':
+        case 'G':
+          shift = 30;
+          break;
+        case '\0':
+          break;
+        default:
+          return false;
+      }
+
+      if ((shift != 0) && (*++s != '\0'))
+        return false;
+
+      if ((digits == 0) || (((v << shift) >> shift) != v))
+        return false;
+
+      value = v << shift;
+      return true;
+    }
+
+    /**
+     * Returns the index of `s` in the null-terminated list `names`, or -1.
+     */
+    static int parse_name(const char* s, const char* const* names)
+    {
+      for (int i = 0; names[i] != nullptr; i++)
+      {
+        if (strcmp(s, names[i]) == 0)
+          return i;
+      }
+
+      return -1;
+    }
+
+    static void invalid(const char* name, const char* value)
+    {
+      FdWriter err(2);
+      err << "snmalloc: ignoring " << name << "=" << value << '\n';
+    }
+
+    static void read_size(
+      const char* name, std::atomic<size_t>& target, size_t min, size_t unit)
+    {
+      const char* v = getenv(name);
+      size_t value;
+
+      if (v == nullptr)
+        return;
+
+      if (!parse_size(v, value) || ((value / unit) < min))
+      {
+        invalid(name, v);
+        return;
+      }
+
+      target.store(value / unit, std::memory_order_relaxed);
+    }
+
+    template<typename T>
+    static bool
+    read_name(const char* name, const char* const* names, T& value)
+    {
+      const char* v = getenv(name);
+
+      if (v == nullptr)
+        return false;
+
+      int i = parse_name(v, names);
+
+      if (i < 0)
+      {
+        invalid(name, v);
+        return false;
+      }
+
+      value = (T)i;
+      return true;
+    }
+
+  public:
+    static void read()
+    {
+#if !defined(OPEN_ENCLAVE) && !defined(FreeBSD_KERNEL)
+      auto& c = runtime_config;
+
+      read_size("SNMALLOC_REMOTE_CACHE", c.remote_cache, 0, 1);
+      read_size(
+        "SNMALLOC_REMOTE_CACHE_OBJECTS", c.remote_cache_objects, 1, 1);
+      read_size("SNMALLOC_REMOTE_CACHE_TICKS", c.remote_cache_ticks, 0, 1);
+      read_size("SNMALLOC_REMOTE_BATCH", c.remote_batch, 1, 1);
+      read_size(
+        "SNMALLOC_RESERVE_SIZE", c.reserve_multiple, 1, SUPERSLAB_SIZE);
+      read_size("SNMALLOC_PROFILE_INTERVAL", c.profile_interval, 0, 1);
+      read_size("SNMALLOC_TRACE_EVENTS", c.trace_events, 1, 1);
+
+      const char* const decommit[] = {"none", "super", "all", nullptr};
+      DecommitStrategy strategy;
+      if (read_name("SNMALLOC_DECOMMIT", decommit, strategy))
+      {
+        // Whether single slabs are decommitted cannot change at run time.
+        if ((strategy == DecommitAll) == (decommit_strategy == DecommitAll))
+          chunk_decommit_strategy = strategy;
+        else
+          invalid("SNMALLOC_DECOMMIT", decommit[strategy]);
+      }
+
+      const char* const thp[] = {"default", "always", "never", nullptr};
+      HugePages huge;
+      if (read_name("SNMALLOC_THP", thp, huge))
+        c.huge_pages.store(huge, std::memory_order_relaxed);
+
+      const char* stats = getenv("SNMALLOC_STATS_FILE");
+      if (stats != nullptr)
+        c.stats_file.store(stats, std::memory_order_relaxed);
+
+      const char* trace = getenv("SNMALLOC_TRACE_FILE");
+      if (trace != nullptr)
+        c.trace_file.store(trace, std::memory_order_relaxed);
+#endif
+    }
+  };
+}
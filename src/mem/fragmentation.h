@@ -0,0 +1,165 @@
+#pragma once
+
+#include "../ds/fdwriter.h"
+#include "alloc.h"
+
+namespace snmalloc
+{
+  /**
+   * Occupancy of every slab in use, found by walking the pagemap.  This
+   * shows how much of the memory held in superslabs and medium slabs is live
+   * data, and how many superslabs are kept alive by only a few objects.
+   *
+   * Slab metadata is read without synchronisation, so the report is only
+   * exact if no other thread is allocating while it is taken.
+   */
+  struct FragmentationReport
+  {
+    // Slabs are counted in buckets of this many tenths of occupancy; the
+    // last bucket is for completely full slabs.
+    static constexpr size_t OCCUPANCY_BUCKETS = 11;
+
+    // A slab at or below this percentage occupancy is nearly empty.
+    static constexpr size_t SPARSE_PERCENT = 10;
+
+    struct Sizeclass
+    {
+      size_t slabs;
+      size_t full_slabs;
+      size_t sparse_slabs;
+      size_t objects;
+      size_t capacity;
+      size_t occupancy[OCCUPANCY_BUCKETS];
+    };
+
+    Sizeclass sizeclass[NUM_SIZECLASSES];
+
+    size_t superslabs;
+    size_t mediumslabs;
+
+    // Superslabs whose slabs are all nearly empty, and medium slabs that are
+    // nearly empty.  Freeing the few objects in these would return a whole
+    // superslab-sized chunk.
+    size_t pinned_superslabs;
+    size_t pinned_mediumslabs;
+
+    void add_slab(uint8_t sc, size_t objects, size_t capacity, bool full)
+    {
+      auto& s = sizeclass[sc];
+      size_t bucket = (objects * 10) / capacity;
+
+      s.slabs++;
+      s.objects += objects;
+      s.capacity += capacity;
+      s.occupancy[bucket]++;
+
+      if (full)
+        s.full_slabs++;
+
+      if (is_sparse(objects, capacity))
+        s.sparse_slabs++;
+    }
+
+    static bool is_sparse(size_t objects, size_t capacity)
+    {
+      return (objects * 100) <= (capacity * SPARSE_PERCENT);
+    }
+
+    void add_superslab(Superslab* super)
+    {
+      bool pinned = true;
+
+      for (size_t i = 0; i < SLAB_COUNT; i++)
+      {
+        Slab* slab = (Slab*)((size_t)super + (i << SLAB_BITS));
+        Metaslab* meta = super->get_meta(slab);
+
+        if (meta->is_unused())
+          continue;
+
+        uint8_t sc = meta->sizeclass;
+        size_t offset = (size_t)get_slab_offset(sc, i == 0) - 1;
+        size_t capacity = (SLAB_SIZE - offset) / sizeclass_to_size(sc);
+        size_t objects = (std::min)((size_t)meta->get_used(), capacity);
+
+        add_slab(sc, objects, capacity, meta->is_full());
+        pinned = pinned && is_sparse(objects, capacity);
+      }
+
+      superslabs++;
+
+      if (pinned && !super->is_empty())
+        pinned_superslabs++;
+    }
+
+    void add_mediumslab(Mediumslab* slab)
+    {
+      uint8_t sc = slab->get_sizeclass();
+      size_t capacity = medium_slab_free(sc);
+      size_t free = (std::min)((size_t)slab->get_free(), capacity);
+      size_t objects = capacity - free;
+
+      mediumslabs++;
+
+      if (objects == 0)
+        return;
+
+      add_slab(sc, objects, capacity, slab->full());
+
+      if (is_sparse(objects, capacity))
+        pinned_mediumslabs++;
+    }
+
+    /**
+     * Walk the global pagemap and fill in the report.  Only the parts of the
+     * pagemap that have been populated are visited, so this costs time in
+     * proportion to the address space snmalloc has reserved.
+     */
+    void collect()
+    {
+      memset(this, 0, sizeof(FragmentationReport));
+
+      global_pagemap.for_each([this](void* p, uint8_t kind) {
+        if (kind == PMSuperslab)
+          add_superslab((Superslab*)p);
+        else if (kind == PMMediumslab)
+          add_mediumslab((Mediumslab*)p);
+      });
+    }
+
+    /**
+     * Write the report as CSV: one row per sizeclass in use, then the totals.
+     */
+    void print(int fd)
+    {
+      FdWriter out(fd);
+
+      out << "sizeclass, size, slabs, full, sparse, objects, capacity";
+      for (size_t i = 0; i < OCCUPANCY_BUCKETS; i++)
+        out << ", " << (i * 10) << '%';
+      out << '\n';
+
+      for (size_t sc = 0; sc < NUM_SIZECLASSES; sc++)
+      {
+        auto& s = sizeclass[sc];
+
+        if (s.slabs == 0)
+          continue;
+
+        out << sc << ", " << sizeclass_to_size((uint8_t)sc) << ", " << s.slabs
+            << ", " << s.full_slabs << ", " << s.sparse_slabs << ", "
+            << s.objects << ", " << s.capacity;
+
+        for (size_t i = 0; i < OCCUPANCY_BUCKETS; i++)
+          out << ", " << s.occupancy[i];
+
+        out << '\n';
+      }
+
+      out << "superslabs, " << superslabs << '\n'
+          << "mediumslabs, " << mediumslabs << '\n'
+          << "pinned_superslabs, " << pinned_superslabs << '\n'
+          << "pinned_mediumslabs, " << pinned_mediumslabs << '\n';
+    }
+  };
+}
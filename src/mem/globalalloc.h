@@ -2,6 +2,7 @@
 
 #include "../ds/helpers.h"
 #include "alloc.h"
+#include "envconfig.h"
 #include "typealloc.h"
 
 namespace snmalloc
@@ -22,14 +23,24 @@ namespace snmalloc
       return (AllocPool*)Parent::make(mp);
     }
 
+    /**
+     * Create the global pool.  This happens before any allocator exists, so
+     * it is where the environment is read.
+     */
     static AllocPool* make() noexcept
     {
+      EnvConfig::read();
       return make(default_memory_provider);
     }
 
     Alloc* acquire()
     {
-      return Parent::alloc(Parent::memory_provider);
+      Alloc* a = Parent::alloc(Parent::memory_provider);
+
+      // Sampling may have been enabled before this allocator was on the list
+      // that `update_profiling` walks.
+      a->update_profiling();
+      return a;
     }
 
     void release(Alloc* a)
@@ -38,6 +49,18 @@ namespace snmalloc
     }
 
   public:
+    /**
+     * Make every allocator sample for the heap profile, after sampling has
+     * been enabled in `runtime_config`.
+     */
+    void update_profiling()
+    {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      for (Alloc* a = Parent::iterate(); a != nullptr; a = Parent::iterate(a))
+        a->update_profiling();
+    }
+
     void aggregate_stats(Stats& stats)
     {
       auto* alloc = Parent::iterate();
@@ -49,6 +72,33 @@ namespace snmalloc
       }
     }
 
+    /**
+     * Iterate over every allocator that this pool has created, including
+     * those that are not in use.  Pass `nullptr` to get the first allocator.
+     */
+    Alloc* iterate(Alloc* a = nullptr)
+    {
+      return Parent::iterate(a);
+    }
+
+    /**
+     * Returns the number of allocators that this pool has created, including
+     * those that have been released and are waiting to be reused.
+     */
+    size_t allocator_count()
+    {
+      size_t count = 0;
+      auto* alloc = Parent::iterate();
+
+      while (alloc != nullptr)
+      {
+        count++;
+        alloc = Parent::iterate(alloc);
+      }
+
+      return count;
+    }
+
     void print_all_stats(std::ostream& o, uint64_t dumpid = 0)
     {
       auto alloc = Parent::iterate();
@@ -76,11 +126,12 @@ namespace snmalloc
         while (alloc != nullptr)
         {
           alloc->handle_message_queue();
+          alloc->handle_slab_remotes();
           last = alloc;
           alloc = Parent::extract(alloc);
         }
 
-        restore(first, last);
+        Parent::restore(first, last);
       }
 #endif
     }
@@ -123,6 +174,9 @@ namespace snmalloc
           // Place the static stub message on the queue.
           alloc->init_message_queue();
 
+          // Free objects pushed directly on the owner's slabs.
+          alloc->handle_slab_remotes();
+
           // Post all remotes, including forwarded ones. If any allocator posts,
           // repeat the loop.
           if (alloc->remote.size > 0)
@@ -154,11 +208,24 @@ namespace snmalloc
     }
   };
 
+  using GlobalAllocPool =
+    Singleton<AllocPool<GlobalVirtual>*, AllocPool<GlobalVirtual>::make>;
+
   inline AllocPool<GlobalVirtual>*& current_alloc_pool()
   {
-    return Singleton<
-      AllocPool<GlobalVirtual>*,
-      AllocPool<GlobalVirtual>::make>::get();
+    return GlobalAllocPool::get();
+  }
+
+  /**
+   * Returns the global pool, or `nullptr` if nothing has allocated yet.
+   * Unlike `current_alloc_pool`, this never creates the pool.
+   */
+  inline AllocPool<GlobalVirtual>* existing_alloc_pool()
+  {
+    if (!GlobalAllocPool::is_initialised())
+      return nullptr;
+
+    return GlobalAllocPool::get();
   }
 
   template<class MemoryProvider>
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "../ds/helpers.h"
+#include "alloc.h"
+#include "typealloc.h"
+
+namespace snmalloc
+{
+  /**
+   * Record of a region of address space reserved on behalf of a heap.
+   */
+  struct HeapRegion : public TypeAllocated<HeapRegion>
+  {
+    void* base = nullptr;
+    size_t size = 0;
+    HeapRegion* next_region = nullptr;
+  };
+
+  inline TypeAlloc<HeapRegion>*& heap_region_pool()
+  {
+    return Singleton<TypeAlloc<HeapRegion>*, TypeAlloc<HeapRegion>::make>::
+      get();
+  }
+
+  /**
+   * Platform wrapper used as the memory provider for a heap.  This forwards
+   * everything to the platform, but records every reservation so that the
+   * address space can be handed back in one go when the heap is destroyed.
+   *
+   * Every reservation is trimmed to whole, aligned superslabs, so that all
+   * of it can be handed back as superslabs.
+   */
+  class HeapPal : public Pal
+  {
+    HeapRegion* regions = nullptr;
+
+  public:
+    template<bool committed>
+    void* reserve(size_t* size, size_t align) noexcept
+    {
+      *size = bits::align_up(*size, SUPERSLAB_SIZE);
+      if (align < SUPERSLAB_SIZE)
+        align = SUPERSLAB_SIZE;
+
+      void* p = Pal::template reserve<committed>(size, align);
+
+      // The platform reserves enough extra to align, so the aligned part
+      // still covers the request.
+      size_t start = bits::align_up((size_t)p, SUPERSLAB_SIZE);
+      size_t end = bits::align_down((size_t)p + *size, SUPERSLAB_SIZE);
+      p = (void*)start;
+      *size = end - start;
+
+      HeapRegion* r = heap_region_pool()->alloc();
+      r->base = p;
+      r->size = *size;
+      r->next_region = regions;
+      regions = r;
+
+      return p;
+    }
+
+    /**
+     * Returns the list of regions reserved so far and forgets about them.
+     */
+    HeapRegion* take_regions()
+    {
+      HeapRegion* r = regions;
+      regions = nullptr;
+      return r;
+    }
+  };
+
+  using HeapVirtual = MemoryProviderStateMixin<HeapPal>;
+
+  /**
+   * An independent heap.  A heap owns its own set of superslabs and large
+   * allocations, which are never shared with any other allocator, so the
+   * whole heap can be torn down with `destroy` without freeing each object.
+   *
+   * A heap is not tied to a thread and does no locking of its own: callers
+   * must ensure that only one thread uses a given heap at a time.
+   *
+   * Objects allocated from a heap must only be freed through that heap.
+   * Another allocator may batch up a free for an arbitrarily long time
+   * before sending it to the owner, which could then be after the heap has
+   * been destroyed.  The heap itself may free objects from other allocators.
+   */
+  class Heap : public TypeAllocated<Heap>
+  {
+    template<class T, class MemoryProvider>
+    friend class TypeAlloc;
+
+    using HeapAlloc = Allocator<HeapVirtual>;
+
+    HeapVirtual memory_provider;
+    HeapAlloc allocator;
+
+    Heap() : allocator(memory_provider) {}
+
+    static TypeAlloc<Heap>*& pool()
+    {
+      return Singleton<TypeAlloc<Heap>*, TypeAlloc<Heap>::make>::get();
+    }
+
+    /**
+     * Forward frees of objects owned by other allocators, which may be
+     * sitting in the message queue or in the remote cache of this heap.
+     */
+    void flush_remote()
+    {
+      Remote* p = allocator.message_queue().destroy();
+
+      while (p != nullptr)
+      {
+        Remote* next = p->non_atomic_next;
+
+        // Frees of objects owned by this heap are dropped, as their memory is
+        // about to be released.
+        if ((p != &allocator.stub) && (p->target_id() != allocator.id()))
+          allocator.remote.dealloc(p->target_id(), p, p->sizeclass());
+
+        p = next;
+      }
+
+      allocator.init_message_queue();
+
+      if (allocator.remote.size > 0)
+      {
+        allocator.stats().remote_post();
+        allocator.remote.post(allocator.id());
+      }
+    }
+
+    /**
+     * Hand every superslab-sized chunk of the heap's address space to the
+     * global memory provider, ready for reuse by any allocator.
+     */
+    void release_regions()
+    {
+      HeapRegion* r = memory_provider.take_regions();
+
+      while (r != nullptr)
+      {
+        // `HeapPal` only records whole, aligned superslabs.
+        size_t start = (size_t)r->base;
+        size_t end = start + r->size;
+        assert(bits::is_aligned_block<SUPERSLAB_SIZE>(r->base, r->size));
+
+        // Sampled objects are not freed one at a time.
+        heap_profile.forget_range((void*)start, end - start);
+
+        for (size_t p = start; p < end; p += SUPERSLAB_SIZE)
+        {
+          void* super = (void*)p;
+          global_pagemap.set(super, (uint8_t)PMNotOurs);
+
+          // Put the chunk in the state that `LargeAlloc` expects of an entry
+          // on its stack of superslab-sized blocks.
+          if (chunk_decommit_strategy == DecommitNone)
+          {
+            default_memory_provider.template notify_using<NoZero>(
+              super, SUPERSLAB_SIZE);
+          }
+          else
+          {
+            default_memory_provider.template notify_using<NoZero>(
+              super, OS_PAGE_SIZE);
+            default_memory_provider.notify_not_using(
+              (void*)(p + OS_PAGE_SIZE), SUPERSLAB_SIZE - OS_PAGE_SIZE);
+          }
+
+          Largeslab* slab = (Largeslab*)super;
+          slab->init();
+          default_memory_provider.large_stack[0].push(slab);
+        }
+
+        HeapRegion* next = r->next_region;
+        heap_region_pool()->dealloc(r);
+        r = next;
+      }
+    }
+
+  public:
+    /**
+     * Create a new, empty heap.
+     */
+    static Heap* create()
+    {
+      return pool()->alloc();
+    }
+
+    template<ZeroMem zero_mem = NoZero>
+    ALLOCATOR void* alloc(size_t size)
+    {
+      return allocator.template alloc<zero_mem>(size);
+    }
+
+    template<size_t size, ZeroMem zero_mem = NoZero>
+    ALLOCATOR void* alloc()
+    {
+      return allocator.template alloc<size, zero_mem>();
+    }
+
+    void dealloc(void* p)
+    {
+      allocator.dealloc(p);
+    }
+
+    void dealloc(void* p, size_t size)
+    {
+      allocator.dealloc(p, size);
+    }
+
+    template<size_t size>
+    void dealloc(void* p)
+    {
+      allocator.template dealloc<size>(p);
+    }
+
+    /**
+     * Release every object allocated from this heap and return its memory to
+     * the global memory provider.  This takes time proportional to the
+     * amount of address space used by the heap, not to the number of objects
+     * allocated from it.  The heap must not be used after this call.
+     */
+    void destroy()
+    {
+#ifndef USE_MALLOC
+      flush_remote();
+      release_regions();
+
+      // Reset the heap to its initial state, so that it can be handed out
+      // again by `create`.  The fields used by the pool are left intact.
+      new (&memory_provider) HeapVirtual();
+      new (&allocator) HeapAlloc(memory_provider);
+#endif
+      pool()->dealloc(this);
+    }
+  };
+}
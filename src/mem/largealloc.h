@@ -7,6 +7,7 @@
 #include "baseslab.h"
 #include "sizeclass.h"
 
+#include <type_traits>
 #include <utility>
 
 namespace snmalloc
@@ -27,6 +28,19 @@ namespace snmalloc
     }
   };
 
+  // Whether a PAL can be told to use or avoid huge pages for a range.
+  template<class PAL, typename = void>
+  struct pal_supports_huge_pages : std::false_type
+  {};
+
+  template<class PAL>
+  struct pal_supports_huge_pages<
+    PAL,
+    std::void_t<decltype(
+      std::declval<PAL&>().notify_huge_pages(nullptr, 0, true))>>
+  : std::true_type
+  {};
+
   // This represents the state that the large allcoator needs to add to the
   // global state of the allocator.  This is currently stored in the memory
   // provider, so we add this in.
@@ -40,8 +54,7 @@ namespace snmalloc
     std::pair<void*, size_t> reserve_block() noexcept
     {
       size_t size = SUPERSLAB_SIZE;
-      void* r = ((MemoryProviderState*)this)
-                  ->template reserve<false>(&size, SUPERSLAB_SIZE);
+      void* r = reserve<false>(&size, SUPERSLAB_SIZE);
 
       if (size < SUPERSLAB_SIZE)
         error("out of memory");
@@ -57,6 +70,29 @@ namespace snmalloc
      */
     MPMCStack<Largeslab, PreZeroed> large_stack[NUM_LARGE_CLASSES];
 
+    /**
+     * Reserve address space from the platform, applying the huge page policy
+     * from `runtime_config`.  The policy is read here, rather than in the
+     * PAL, so that the PAL does not depend on allocator state.
+     */
+    template<bool committed>
+    void* reserve(size_t* size, size_t align) noexcept
+    {
+      void* p = MemoryProviderState::template reserve<committed>(size, align);
+
+      if constexpr (pal_supports_huge_pages<MemoryProviderState>::value)
+      {
+        HugePages huge =
+          runtime_config.huge_pages.load(std::memory_order_relaxed);
+
+        if (huge != HugePagesDefault)
+          MemoryProviderState::notify_huge_pages(
+            p, *size, huge == HugePagesAlways);
+      }
+
+      return p;
+    }
+
     /**
      * Primitive allocator for structure that are required before
      * the allocator can be running.
@@ -109,7 +145,7 @@ namespace snmalloc
     void* reserved_end = nullptr;
 
   public:
-    // This will be a zero-size structure if stats are not enabled.
+    // Only the always-on counters are present if stats are not enabled.
     Stats stats;
 
     MemoryProvider& memory_provider;
@@ -123,9 +159,9 @@ namespace snmalloc
       {
         if (allow_reserve == YesReserve)
         {
-          stats.segment_create();
           reserved_start =
             memory_provider.template reserve<false>(&add, SUPERSLAB_SIZE);
+          stats.segment_create(add);
           reserved_end = (void*)((size_t)reserved_start + add);
           reserved_start =
             (void*)bits::align_up((size_t)reserved_start, SUPERSLAB_SIZE);
@@ -150,19 +186,25 @@ namespace snmalloc
         size = rsize;
 
       void* p = memory_provider.large_stack[large_class].pop();
+      stats.chunk_alloc(rsize);
 
       if (p == nullptr)
       {
         assert(reserved_start <= reserved_end);
         size_t add;
+        size_t reserve_size = SUPERSLAB_SIZE *
+          runtime_config.reserve_multiple.load(std::memory_order_relaxed);
 
-        if ((rsize + SUPERSLAB_SIZE) < RESERVE_SIZE)
-          add = RESERVE_SIZE;
+        if ((rsize + SUPERSLAB_SIZE) < reserve_size)
+          add = reserve_size;
         else
           add = rsize + SUPERSLAB_SIZE;
 
         if (!reserve_memory<allow_reserve>(rsize, add))
+        {
+          stats.chunk_dealloc(rsize);
           return nullptr;
+        }
 
         p = (void*)reserved_start;
         reserved_start = (void*)((size_t)p + rsize);
@@ -172,7 +214,7 @@ namespace snmalloc
       }
       else
       {
-        if ((decommit_strategy != DecommitNone) || (large_class > 0))
+        if ((chunk_decommit_strategy != DecommitNone) || (large_class > 0))
         {
           // Only the first page needs to be zeroed, as this was decommitted.
           if (zero_mem == YesZero)
@@ -194,6 +236,7 @@ namespace snmalloc
 
     void dealloc(void* p, size_t large_class)
     {
+      stats.chunk_dealloc(((size_t)1 << SUPERSLAB_BITS) << large_class);
       memory_provider.large_stack[large_class].push((Largeslab*)p);
     }
   };
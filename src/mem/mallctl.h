@@ -0,0 +1,413 @@
+#pragma once
+
+#include "globalalloc.h"
+
+#include <cstring>
+#include <errno.h>
+
+namespace snmalloc
+{
+  /**
+   * Implementation of a jemalloc-style `mallctl` interface.  Names are dotted
+   * paths, with numeric components for indices, for example
+   * `stats.sizeclass.3.count`:
+   *
+   *  - `epoch`: incremented on write; stats are always read live.
+   *  - `config.*`: read-only build configuration, including the size of
+   *    each sizeclass as `config.sizeclass.<i>.size`.
+   *  - `opt.*`: tunables.  `remote_cache`, `remote_cache_objects`,
+   *    `remote_cache_ticks`, `remote_batch`, `reserve_multiple` and
+   *    `profile_interval` can be written at any time;
+   *    `decommit` and `huge_pages` can only be set from the environment.
+   *  - `prof.*`: the sampling heap profile.  `prof.samples` is the number of
+   *    live sampled objects, and writing a file name to `prof.dump` writes
+   *    the profile to that file in `pprof` format.
+   *  - `stats.*`: statistics summed over all allocators, with the same
+   *    statistics for a single allocator under `stats.allocator.<j>.*`.
+   *    Counts of allocations, frees, slabs, remote frees and bytes reserved
+   *    and committed are always present; the remainder only if snmalloc was
+   *    built with `USE_SNMALLOC_STATS`.  All are read without
+   *    synchronisation, so they are approximate while other threads are
+   *    allocating.  Memory is committed by one allocator and released by
+   *    whichever frees its last object, so `committed` is only exact in the
+   *    sum; for a single allocator it is clamped at zero.
+   *
+   * As with jemalloc, an unknown name gives `ENOENT`, writing a read-only
+   * value gives `EPERM`, and a buffer of the wrong size or an invalid value
+   * gives `EINVAL`.
+   */
+  class MallCtl
+  {
+    /**
+     * Cursor over the components of a dotted name.
+     */
+    class Name
+    {
+      const char* p;
+
+      bool next(size_t len)
+      {
+        if (p[len] == '.')
+        {
+          p += len + 1;
+          return true;
+        }
+
+        if (p[len] == '\0')
+        {
+          p += len;
+          return true;
+        }
+
+        return false;
+      }
+
+    public:
+      Name(const char* name) : p(name) {}
+
+      /**
+       * Consume `component` if it is the next component of the name.
+       */
+      bool match(const char* component)
+      {
+        size_t len = strlen(component);
+        return (strncmp(p, component, len) == 0) && next(len);
+      }
+
+      /**
+       * Consume the next component if it is a number less than `bound`.
+       */
+      bool index(size_t bound, size_t& i)
+      {
+        size_t len = 0;
+        i = 0;
+
+        while ((p[len] >= '0') && (p[len] <= '9') && (i < bound))
+          i = (i * 10) + (size_t)(p[len++] - '0');
+
+        return (len > 0) && (i < bound) && next(len);
+      }
+
+      /**
+       * Consume the last component if it is `component`.
+       */
+      bool leaf(const char* component)
+      {
+        size_t len = strlen(component);
+        return (strncmp(p, component, len) == 0) && (p[len] == '\0') &&
+          next(len);
+      }
+    };
+
+    struct Request
+    {
+      void* oldp;
+      size_t* oldlenp;
+      void* newp;
+      size_t newlen;
+    };
+
+    template<typename T>
+    static int read(Request& r, T value)
+    {
+      if (r.newp != nullptr)
+        return EPERM;
+
+      if ((r.oldp == nullptr) || (r.oldlenp == nullptr))
+        return 0;
+
+      if (*r.oldlenp != sizeof(T))
+      {
+        size_t len = (std::min)(*r.oldlenp, sizeof(T));
+        memcpy(r.oldp, &value, len);
+        *r.oldlenp = len;
+        return EINVAL;
+      }
+
+      memcpy(r.oldp, &value, sizeof(T));
+      return 0;
+    }
+
+    template<typename T>
+    static int read_write(Request& r, std::atomic<T>& value, T min)
+    {
+      T n = value.load(std::memory_order_relaxed);
+
+      if (r.newp != nullptr)
+      {
+        if (r.newlen != sizeof(T))
+          return EINVAL;
+
+        memcpy(&n, r.newp, sizeof(T));
+
+        if (n < min)
+          return EINVAL;
+      }
+
+      // Return the old value, then store the new one.
+      Request old = {r.oldp, r.oldlenp, nullptr, 0};
+      int err = read(old, value.load(std::memory_order_relaxed));
+
+      if (err != 0)
+        return err;
+
+      value.store(n, std::memory_order_relaxed);
+      return 0;
+    }
+
+    static std::atomic<uint64_t>& epoch()
+    {
+      static std::atomic<uint64_t> e;
+      return e;
+    }
+
+    static int config(Name& n, Request& r)
+    {
+      size_t i;
+
+      if (n.leaf("stats"))
+      {
+#ifdef USE_SNMALLOC_STATS
+        return read(r, true);
+#else
+        return read(r, false);
+#endif
+      }
+      if (n.leaf("min_alloc_size"))
+        return read(r, MIN_ALLOC_SIZE);
+      if (n.leaf("slab_size"))
+        return read(r, SLAB_SIZE);
+      if (n.leaf("superslab_size"))
+        return read(r, SUPERSLAB_SIZE);
+      if (n.leaf("intermediate_bits"))
+        return read(r, INTERMEDIATE_BITS);
+      if (n.leaf("sizeclasses"))
+        return read(r, NUM_SIZECLASSES);
+      if (n.leaf("large_classes"))
+        return read(r, NUM_LARGE_CLASSES);
+
+      if (n.match("sizeclass"))
+      {
+        if (n.index(NUM_SIZECLASSES, i) && n.leaf("size"))
+          return read(r, sizeclass_to_size((uint8_t)i));
+
+        return ENOENT;
+      }
+
+      if (n.match("large"))
+      {
+        if (n.index(NUM_LARGE_CLASSES, i) && n.leaf("size"))
+          return read(r, large_sizeclass_to_size((uint8_t)i));
+
+        return ENOENT;
+      }
+
+      return ENOENT;
+    }
+
+    static int opt(Name& n, Request& r)
+    {
+      if (n.leaf("remote_cache"))
+        return read_write(r, runtime_config.remote_cache, (size_t)0);
+      if (n.leaf("remote_cache_objects"))
+        return read_write(r, runtime_config.remote_cache_objects, (size_t)1);
+      if (n.leaf("remote_cache_ticks"))
+        return read_write(r, runtime_config.remote_cache_ticks, (size_t)0);
+      if (n.leaf("remote_batch"))
+        return read_write(r, runtime_config.remote_batch, (size_t)1);
+      if (n.leaf("reserve_multiple"))
+        return read_write(r, runtime_config.reserve_multiple, (size_t)1);
+      if (n.leaf("profile_interval"))
+      {
+        int err = read_write(r, runtime_config.profile_interval, (size_t)0);
+
+        if ((err == 0) && (r.newp != nullptr))
+          current_alloc_pool()->update_profiling();
+
+        return err;
+      }
+      if (n.leaf("decommit"))
+      {
+        const char* names[] = {"none", "super", "all"};
+        return read(r, names[chunk_decommit_strategy]);
+      }
+      if (n.leaf("huge_pages"))
+      {
+        const char* names[] = {"default", "always", "never"};
+        return read(r, names[runtime_config.huge_pages.load()]);
+      }
+
+      return ENOENT;
+    }
+
+    static int prof(Name& n, Request& r)
+    {
+      if (n.leaf("samples"))
+        return read(r, heap_profile.samples());
+
+      if (n.leaf("dump"))
+      {
+        const char* path;
+
+        if (
+          (r.oldp != nullptr) || (r.newp == nullptr) ||
+          (r.newlen != sizeof(path)))
+          return EINVAL;
+
+        memcpy(&path, r.newp, sizeof(path));
+        int fd = FdWriter::open(path);
+
+        if (fd < 0)
+          return EFAULT;
+
+        heap_profile.dump(fd);
+        FdWriter::close(fd);
+        return 0;
+      }
+
+      return ENOENT;
+    }
+
+    static int stats(Name& n, Request& r, Stats& s)
+    {
+      size_t i;
+
+      if (n.match("sizeclass"))
+      {
+        if (!n.index(NUM_SIZECLASSES, i))
+          return ENOENT;
+
+        auto& c = s.sizeclass_counters[i];
+
+        if (n.leaf("allocs"))
+          return read(r, c.allocs);
+        if (n.leaf("frees"))
+          return read(r, c.frees);
+        if (n.leaf("slabs"))
+          return read(r, c.slabs);
+
+#ifdef USE_SNMALLOC_STATS
+        auto& sc = s.sizeclass[i];
+
+        if (n.leaf("count"))
+          return read(r, sc.count.current);
+        if (n.leaf("max_count"))
+          return read(r, sc.count.max);
+        if (n.leaf("max_slabs"))
+          return read(r, sc.slab_count.max);
+#endif
+
+        return ENOENT;
+      }
+
+      if (n.match("large"))
+      {
+        if (!n.index(NUM_LARGE_CLASSES, i))
+          return ENOENT;
+
+        auto& c = s.large_counters[i];
+
+        if (n.leaf("allocs"))
+          return read(r, c.allocs);
+        if (n.leaf("frees"))
+          return read(r, c.frees);
+
+#ifdef USE_SNMALLOC_STATS
+        auto& l = s.large[i];
+
+        if (n.leaf("count"))
+          return read(r, l.count.current);
+        if (n.leaf("max_count"))
+          return read(r, l.count.max);
+#endif
+
+        return ENOENT;
+      }
+
+      if (n.leaf("remote_frees"))
+        return read(r, s.remote_frees);
+      if (n.leaf("remote_receives"))
+        return read(r, s.remote_receives);
+      if (n.leaf("reserved"))
+        return read(r, s.reserved);
+      if (n.leaf("committed"))
+        return read(r, s.committed_bytes());
+
+#ifdef USE_SNMALLOC_STATS
+      if (n.leaf("remote_freed"))
+        return read(r, s.remote_freed);
+      if (n.leaf("remote_posted"))
+        return read(r, s.remote_posted);
+      if (n.leaf("remote_received"))
+        return read(r, s.remote_received);
+      if (n.leaf("superslab_push"))
+        return read(r, s.superslab_push_count);
+      if (n.leaf("superslab_pop"))
+        return read(r, s.superslab_pop_count);
+      if (n.leaf("superslab_fresh"))
+        return read(r, s.superslab_fresh_count);
+      if (n.leaf("segments"))
+        return read(r, s.segment_count);
+#endif
+
+      return ENOENT;
+    }
+
+    static int stats(Name& n, Request& r)
+    {
+      auto* pool = current_alloc_pool();
+      size_t j;
+
+      if (n.leaf("allocators"))
+        return read(r, pool->allocator_count());
+
+      if (n.match("allocator"))
+      {
+        if (!n.index(pool->allocator_count(), j))
+          return ENOENT;
+
+        Alloc* a = pool->iterate();
+
+        while (j-- > 0)
+          a = pool->iterate(a);
+
+        if (n.leaf("id"))
+          return read(r, a->get_id());
+
+        return stats(n, r, a->stats());
+      }
+
+      Stats s;
+      pool->aggregate_stats(s);
+      return stats(n, r, s);
+    }
+
+  public:
+    static int ctl(
+      const char* name, void* oldp, size_t* oldlenp, void* newp, size_t newlen)
+    {
+      Name n(name);
+      Request r = {oldp, oldlenp, newp, newlen};
+
+      if (n.leaf("epoch"))
+      {
+        if (newp != nullptr)
+          epoch()++;
+
+        Request old = {oldp, oldlenp, nullptr, 0};
+        return read(old, epoch().load());
+      }
+
+      if (n.match("config"))
+        return config(n, r);
+      if (n.match("opt"))
+        return opt(n, r);
+      if (n.match("prof"))
+        return prof(n, r);
+      if (n.match("stats"))
+        return stats(n, r);
+
+      return ENOENT;
+    }
+  };
+}
@@ -74,6 +74,11 @@ namespace snmalloc
       return sizeclass;
     }
 
+    uint16_t get_free()
+    {
+      return free;
+    }
+
     template<ZeroMem zero_mem, typename MemoryProvider>
     void* alloc(size_t size, MemoryProvider& memory_provider)
     {
@@ -63,6 +63,24 @@ namespace snmalloc
       uint8_t next;
     };
 
+#ifdef USE_SLAB_REMOTE_FREE
+    // Objects in this slab freed by other threads, pushed here rather than
+    // sent to the owner's message queue.  The bottom 16 bits are the index
+    // of the most recently pushed object, which links to the one before it
+    // through its first two bytes, the next 16 bits are the index of the
+    // oldest object, and the next 16 the number of objects.  REMOTE_FULL is
+    // set by the owner when the slab is full, as it then does not look at
+    // this list until the slab is back on its sizeclass list.
+    std::atomic<uint64_t> remote_free;
+
+    static constexpr uint64_t REMOTE_FULL = (uint64_t)1 << 48;
+
+    static uint16_t remote_count(uint64_t r)
+    {
+      return (uint16_t)(r >> 32);
+    }
+#endif
+
     void add_use()
     {
       used++;
@@ -73,6 +91,11 @@ namespace snmalloc
       used--;
     }
 
+    void sub_use(uint16_t count)
+    {
+      used = (uint16_t)(used - count);
+    }
+
     void set_unused()
     {
       used = 0;
@@ -83,6 +106,11 @@ namespace snmalloc
       return used == 0;
     }
 
+    uint16_t get_used()
+    {
+      return used;
+    }
+
     bool is_full()
     {
       return (head & 2) != 0;
@@ -94,6 +122,93 @@ namespace snmalloc
       head = (uint16_t)~0;
     }
 
+#ifdef USE_SLAB_REMOTE_FREE
+    void init_remote()
+    {
+      remote_free.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * Push `p`, an object in `slab`, on the remote free list.  Called by
+     * threads other than the owner.  Returns false without pushing if the
+     * slab is marked full: one thread clears the mark and must send `p` to
+     * the owner by message instead, which puts the slab back on the owner's
+     * sizeclass list.
+     */
+    bool remote_push(Slab* slab, void* p)
+    {
+      uint64_t index = (uint16_t)((size_t)p - (size_t)slab);
+      uint64_t r = remote_free.load(std::memory_order_relaxed);
+
+      while (true)
+      {
+        if ((r & REMOTE_FULL) != 0)
+        {
+          if (remote_free.compare_exchange_weak(
+                r, r & ~REMOTE_FULL, std::memory_order_relaxed))
+            return false;
+
+          continue;
+        }
+
+        uint64_t count = remote_count(r);
+        uint64_t oldest = count == 0 ? index : (r >> 16) & 0xffff;
+        *(uint16_t*)p = (uint16_t)r;
+
+        uint64_t pushed = index | (oldest << 16) | ((count + 1) << 32);
+
+        if (remote_free.compare_exchange_weak(
+              r, pushed, std::memory_order_release, std::memory_order_relaxed))
+          return true;
+      }
+    }
+
+    /**
+     * Take the remote free list of a slab that has just become full, and
+     * make it the slab's free list, with the oldest object as the link.  If
+     * the list is empty, mark the slab full instead.  Returns the number of
+     * objects taken.
+     */
+    uint16_t take_remote()
+    {
+      assert(is_full());
+      uint64_t r = remote_free.load(std::memory_order_relaxed);
+
+      while (true)
+      {
+        if (remote_count(r) == 0)
+        {
+          if (remote_free.compare_exchange_weak(
+                r, REMOTE_FULL, std::memory_order_relaxed))
+            return 0;
+        }
+        else if (remote_free.compare_exchange_weak(
+                   r, 0, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+
+      uint16_t count = remote_count(r);
+      head = (uint16_t)r;
+      link = (uint16_t)(r >> 16);
+      sub_use(count);
+      return count;
+    }
+
+    /**
+     * Take the remote free list of a slab that is not full.  Returns the
+     * index of the most recently pushed object, and sets `count` to the
+     * number of objects in the list.
+     */
+    uint16_t take_remote_all(uint16_t& count)
+    {
+      uint64_t r = remote_free.exchange(0, std::memory_order_acquire);
+      count = remote_count(r);
+      return (uint16_t)r;
+    }
+#endif
+
     SlabLink* get_link(Slab* slab)
     {
       return (SlabLink*)((size_t)slab + link);
@@ -153,6 +153,41 @@ namespace snmalloc
       return std::pair(leaf, ix);
     }
 
+    /**
+     * Visit the non-default entries below the node `e`, which covers the
+     * addresses from `base` and has `levels` index levels beneath it.  Nodes
+     * that have not been populated are skipped.
+     */
+    template<size_t levels, typename F>
+    void for_each_node(std::atomic<PagemapEntry*>* e, size_t base, F& f)
+    {
+      PagemapEntry* value = e->load(std::memory_order_acquire);
+
+      if ((uintptr_t)value <= LOCKED_ENTRY)
+        return;
+
+      if constexpr (levels == 0)
+      {
+        Leaf* leaf = (Leaf*)value;
+
+        for (size_t i = 0; i < ENTRIES_PER_LEAF; i++)
+        {
+          T x = leaf->values[i].load(std::memory_order_relaxed);
+
+          if (x != default_content)
+            f((void*)(base + (i << GRANULARITY_BITS)), x);
+        }
+      }
+      else
+      {
+        constexpr size_t shift = GRANULARITY_BITS + BITS_FOR_LEAF +
+          ((levels - 1) * BITS_PER_INDEX_LEVEL);
+
+        for (size_t i = 0; i < ENTRIES_PER_INDEX_LEVEL; i++)
+          for_each_node<levels - 1>(&value->entries[i], base + (i << shift), f);
+      }
+    }
+
     template<bool create_addr>
     inline std::atomic<T>* get_addr(void* p, bool& success)
     {
@@ -228,6 +263,19 @@ namespace snmalloc
         p = (void*)((uintptr_t)p + (diff << GRANULARITY_BITS));
       } while (length > 0);
     }
+
+    /**
+     * Call `f(p, x)` for every entry `x` that is not the default, where `p`
+     * is the start of the range it covers.  Only the leaves that have been
+     * populated are read, so the cost follows the address space in use
+     * rather than the whole address space.
+     */
+    template<typename F>
+    void for_each(F f)
+    {
+      for (size_t i = 0; i < TOPLEVEL_ENTRIES; i++)
+        for_each_node<INDEX_LEVELS>(&top[i], i << TOPLEVEL_SHIFT, f);
+    }
   };
 
   /**
@@ -272,5 +320,21 @@ namespace snmalloc
         length--;
       } while (length > 0);
     }
+
+    /**
+     * Call `f(p, x)` for every non-zero entry `x`, where `p` is the start of
+     * the range it covers.
+     */
+    template<typename F>
+    void for_each(F f)
+    {
+      for (size_t i = 0; i < ENTRIES; i++)
+      {
+        T x = top[i].load(std::memory_order_relaxed);
+
+        if (x != T())
+          f((void*)(i << SHIFT), x);
+      }
+    }
   };
 }
@@ -0,0 +1,374 @@
+#pragma once
+
+#include "../ds/fdwriter.h"
+#include "../ds/flaglock.h"
+#include "largealloc.h"
+
+#include <cmath>
+#if !defined(_WIN32) && defined(__GNUC__) && !defined(OPEN_ENCLAVE) && \
+  !defined(FreeBSD_KERNEL)
+#  include <unwind.h>
+#  define SNMALLOC_PROFILE_UNWIND
+#endif
+
+namespace snmalloc
+{
+  // Maximum number of frames recorded for each sample.
+  static constexpr size_t PROFILE_MAX_DEPTH = 32;
+
+  // While profiling is disabled, each allocator checks whether it has been
+  // enabled once per this many bytes allocated.
+  static constexpr size_t PROFILE_RECHECK = 1 << 20;
+
+  struct ProfileSample
+  {
+    ProfileSample* next;
+    void* p;
+    size_t size;
+    size_t depth;
+    void* stack[PROFILE_MAX_DEPTH];
+  };
+
+  /**
+   * Side table of sampled live allocations.  Allocators decide when to take
+   * a sample, from a byte countdown drawn from an exponential distribution
+   * with a mean of `runtime_config.profile_interval` bytes, so that the
+   * chance of sampling an object is proportional to its size.
+   *
+   * While profiling is off, allocation and deallocation test a single flag
+   * in the allocator and nothing else; the countdown and the checks below
+   * are only reached once the flag is set.
+   *
+   * Sampled addresses are also counted in a small array of marks, indexed by
+   * a hash of the address.  A profiled free reads the mark without locking
+   * and only looks in the table if it is set, so frees of unsampled objects
+   * stay off the table's locks except on a hash collision.  The table is
+   * split into stripes, each with its own lock, and a mark is only ever
+   * updated under the lock of the stripe that owns it.
+   *
+   * Objects in a `Heap` are dropped from the table when the heap is
+   * destroyed.  Objects in an `Arena` are never sampled.
+   */
+  class HeapProfile
+  {
+    static constexpr size_t MARK_BITS = 16;
+    static constexpr size_t MARKS = 1 << MARK_BITS;
+    static constexpr size_t STRIPE_BITS = 6;
+    static constexpr size_t STRIPES = 1 << STRIPE_BITS;
+    static constexpr size_t BUCKET_BITS = 8;
+    static constexpr size_t BUCKETS = 1 << BUCKET_BITS;
+
+    // A mark that reaches this count is never decremented again.
+    static constexpr uint8_t MARK_SATURATED = UINT8_MAX;
+
+    struct alignas(CACHELINE_SIZE) Stripe
+    {
+      std::atomic_flag lock = ATOMIC_FLAG_INIT;
+      ProfileSample* buckets[BUCKETS] = {};
+      ProfileSample* free_samples = nullptr;
+      size_t live_bytes = 0;
+      size_t total_count = 0;
+      size_t total_bytes = 0;
+    };
+
+    std::atomic<size_t> live{0};
+    std::atomic<uint8_t> marks[MARKS] = {};
+    Stripe stripes[STRIPES];
+
+    static size_t mark(void* p)
+    {
+      return bits::hash(p) & (MARKS - 1);
+    }
+
+    // Both the stripe and the bucket are taken from the mark index, so that
+    // every sample sharing a mark is protected by the same lock.
+    Stripe& stripe(size_t m)
+    {
+      return stripes[m & (STRIPES - 1)];
+    }
+
+    static size_t bucket(size_t m)
+    {
+      return (m >> STRIPE_BITS) & (BUCKETS - 1);
+    }
+
+    void remove(Stripe& st, ProfileSample** prev)
+    {
+      ProfileSample* s = *prev;
+      *prev = s->next;
+      s->next = st.free_samples;
+      st.free_samples = s;
+      st.live_bytes -= s->size;
+      live--;
+
+      std::atomic<uint8_t>& c = marks[mark(s->p)];
+      uint8_t n = c.load(std::memory_order_relaxed);
+
+      if (n != MARK_SATURATED)
+        c.store(n - 1, std::memory_order_relaxed);
+    }
+
+    static void lock(Stripe& st)
+    {
+      while (st.lock.test_and_set(std::memory_order_acquire))
+        bits::pause();
+    }
+
+    static void unlock(Stripe& st)
+    {
+      st.lock.clear(std::memory_order_release);
+    }
+
+#ifdef SNMALLOC_PROFILE_UNWIND
+    struct Unwind
+    {
+      void** stack;
+      size_t depth;
+      size_t skip;
+    };
+
+    static _Unwind_Reason_Code unwind_frame(_Unwind_Context* ctx, void* arg)
+    {
+      Unwind* u = (Unwind*)arg;
+      void* ip = (void*)_Unwind_GetIP(ctx);
+
+      if ((ip == nullptr) || (u->depth == PROFILE_MAX_DEPTH))
+        return _URC_END_OF_STACK;
+
+      if (u->skip > 0)
+        u->skip--;
+      else
+        u->stack[u->depth++] = ip;
+
+      return _URC_NO_REASON;
+    }
+#endif
+
+  public:
+    /**
+     * Returns true if any sampled object is live.
+     */
+    ALWAYSINLINE bool has_samples()
+    {
+      return live.load(std::memory_order_relaxed) != 0;
+    }
+
+    /**
+     * Returns false if `p` is definitely not a sampled object.  Deallocation
+     * only needs to look in the table if this is true.
+     */
+    ALWAYSINLINE bool maybe_sampled(void* p)
+    {
+      return has_samples() &&
+        (marks[mark(p)].load(std::memory_order_relaxed) != 0);
+    }
+
+    size_t samples()
+    {
+      return live.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the number of bytes to allocate before taking the next sample,
+     * advancing the random state `rng`.
+     */
+    static size_t next_interval(uint64_t& rng, size_t mean)
+    {
+      rng ^= rng << 13;
+      rng ^= rng >> 7;
+      rng ^= rng << 17;
+
+      // Uniform in (0, 1], so the logarithm is finite.
+      double u = (double)((rng >> 11) + 1) * (1.0 / (double)(1ULL << 53));
+      double n = -std::log(u) * (double)mean;
+
+      if (n >= (double)(SIZE_MAX >> 1))
+        return SIZE_MAX >> 1;
+
+      return (size_t)n;
+    }
+
+    /**
+     * Capture the current stack, omitting the innermost `skip` frames.
+     */
+    NOINLINE static size_t backtrace(void** stack, size_t skip)
+    {
+#if defined(SNMALLOC_PROFILE_UNWIND)
+      // Skip this frame as well.
+      Unwind u = {stack, 0, skip + 1};
+      _Unwind_Backtrace(unwind_frame, &u);
+      return u.depth;
+#elif defined(_WIN32) && !defined(OPEN_ENCLAVE)
+      return RtlCaptureStackBackTrace(
+        (DWORD)(skip + 1), (DWORD)PROFILE_MAX_DEPTH, stack, nullptr);
+#else
+      UNUSED(stack);
+      UNUSED(skip);
+      return 0;
+#endif
+    }
+
+    /**
+     * Add a sampled object to the table, replacing any stale sample at the
+     * same address.
+     */
+    void record(void* p, size_t size, void** stack, size_t depth)
+    {
+      size_t m = mark(p);
+      Stripe& st = stripe(m);
+      FlagLock f(st.lock);
+      ProfileSample** head = &st.buckets[bucket(m)];
+
+      for (ProfileSample** prev = head; *prev != nullptr;
+           prev = &(*prev)->next)
+      {
+        if ((*prev)->p == p)
+        {
+          remove(st, prev);
+          break;
+        }
+      }
+
+      ProfileSample* s = st.free_samples;
+
+      if (s != nullptr)
+        st.free_samples = s->next;
+      else
+        s = (ProfileSample*)default_memory_provider.alloc_chunk(
+          sizeof(ProfileSample));
+
+      s->p = p;
+      s->size = size;
+      s->depth = depth;
+      memcpy(s->stack, stack, depth * sizeof(void*));
+      s->next = *head;
+      *head = s;
+
+      st.live_bytes += size;
+      st.total_count++;
+      st.total_bytes += size;
+      live++;
+
+      uint8_t n = marks[m].load(std::memory_order_relaxed);
+
+      if (n != MARK_SATURATED)
+        marks[m].store(n + 1, std::memory_order_relaxed);
+
+      // An allocator that found sampling off and no sample live stops
+      // checking its frees.  If sampling was switched off after the caller
+      // decided to take this sample, that may already have happened, so drop
+      // the sample rather than let it outlive its object.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      if (runtime_config.profile_interval.load(std::memory_order_relaxed) == 0)
+        remove(st, head);
+    }
+
+    /**
+     * Remove the sample for `p`, if there is one.
+     */
+    NOINLINE void forget(void* p)
+    {
+      size_t m = mark(p);
+      Stripe& st = stripe(m);
+      FlagLock f(st.lock);
+
+      for (ProfileSample** prev = &st.buckets[bucket(m)]; *prev != nullptr;
+           prev = &(*prev)->next)
+      {
+        if ((*prev)->p == p)
+        {
+          remove(st, prev);
+          return;
+        }
+      }
+    }
+
+    /**
+     * Remove all samples in the range [base, base + size).
+     */
+    void forget_range(void* base, size_t size)
+    {
+      if (!has_samples())
+        return;
+
+      for (Stripe& st : stripes)
+      {
+        FlagLock f(st.lock);
+
+        for (size_t i = 0; i < BUCKETS; i++)
+        {
+          ProfileSample** prev = &st.buckets[i];
+
+          while (*prev != nullptr)
+          {
+            size_t offset = (size_t)(*prev)->p - (size_t)base;
+
+            if (offset < size)
+              remove(st, prev);
+            else
+              prev = &(*prev)->next;
+          }
+        }
+      }
+    }
+
+    /**
+     * Write the live samples to `fd` in the gperftools heap profile format
+     * understood by `pprof`.  Counts are raw samples; `pprof` scales them
+     * using the sampling interval in the header.
+     */
+    void dump(int fd)
+    {
+      FdWriter out(fd);
+      size_t live_bytes = 0;
+      size_t total_count = 0;
+      size_t total_bytes = 0;
+
+      // Hold every stripe, always in the same order, so the header agrees
+      // with the samples that follow it.
+      for (Stripe& st : stripes)
+      {
+        lock(st);
+        live_bytes += st.live_bytes;
+        total_count += st.total_count;
+        total_bytes += st.total_bytes;
+      }
+
+      out << "heap profile: " << live.load(std::memory_order_relaxed) << ": "
+          << live_bytes << " [" << total_count << ": " << total_bytes
+          << "] @ heap_v2/"
+          << runtime_config.profile_interval.load(std::memory_order_relaxed)
+          << '\n';
+
+      for (Stripe& st : stripes)
+      {
+        for (size_t i = 0; i < BUCKETS; i++)
+        {
+          for (ProfileSample* s = st.buckets[i]; s != nullptr; s = s->next)
+          {
+            out << "1: " << s->size << " [1: " << s->size << "] @";
+
+            for (size_t j = 0; j < s->depth; j++)
+            {
+              out << ' ';
+              out.hex((size_t)s->stack[j]);
+            }
+
+            out << '\n';
+          }
+        }
+      }
+
+      for (Stripe& st : stripes)
+        unlock(st);
+
+#ifdef __linux__
+      out << "\nMAPPED_LIBRARIES:\n";
+      out.append_file("/proc/self/maps");
+#endif
+    }
+  };
+
+  HEADER_GLOBAL HeapProfile heap_profile;
+}
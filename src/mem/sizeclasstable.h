@@ -68,4 +68,51 @@ namespace snmalloc
   {
     return sizeclass_metadata.medium_slab_slots[sizeclass - NUM_SMALL_CLASSES];
   }
+
+  /**
+   * Returns the size that an allocation of `size` bytes is rounded up to, or
+   * zero if that size cannot be allocated.  Allocating exactly this size
+   * leaves no space unused in the object.
+   */
+  constexpr static inline size_t round_size(size_t size)
+  {
+    if (size == 0)
+      size = 1;
+
+    if (size <= sizeclass_to_size(NUM_SIZECLASSES - 1))
+      return sizeclass_to_size(size_to_sizeclass_const(size));
+
+    if (size > large_sizeclass_to_size(NUM_LARGE_CLASSES - 1))
+      return 0;
+
+    return bits::next_pow2_const(size);
+  }
+
+  /**
+   * Returns the smallest size, of at least `size` bytes, for which every
+   * object is aligned to `alignment`, or zero if there is no such size.
+   * Objects larger than a superslab are always aligned to a superslab.
+   */
+  constexpr static inline size_t aligned_size(size_t alignment, size_t size)
+  {
+    if (alignment > SUPERSLAB_SIZE)
+      return 0;
+
+    if (size < alignment)
+      size = alignment;
+
+    if (size <= sizeclass_to_size(NUM_SIZECLASSES - 1))
+    {
+      for (uint8_t sc = size_to_sizeclass_const(size); sc < NUM_SIZECLASSES;
+           sc++)
+      {
+        size_t rsize = sizeclass_to_size(sc);
+
+        if ((rsize & (~rsize + 1)) >= alignment)
+          return rsize;
+      }
+    }
+
+    return round_size(size);
+  }
 }
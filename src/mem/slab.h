@@ -157,6 +157,29 @@ namespace snmalloc
       return Superslab::NoSlabReturn;
     }
 
+    /**
+     * Free `count` objects with one update to the metadata.  The objects
+     * are linked through their first two bytes, from the index `head` to
+     * `last`.  Returns false, freeing nothing, if the slab is full or would
+     * become unused, as then it must move between lists.
+     */
+    bool dealloc_run(uint16_t head, void* last, uint16_t count)
+    {
+      Metaslab* meta = get_meta();
+
+      if (meta->is_full() || (meta->get_used() <= count))
+        return false;
+
+      meta->debug_slab_invariant(is_short(), this);
+      meta->sub_use(count);
+
+      *(uint16_t*)last = meta->head;
+      meta->head = head;
+      assert(meta->valid_head(is_short()));
+      meta->debug_slab_invariant(is_short(), this);
+      return true;
+    }
+
     bool is_short()
     {
       return ((size_t)this & SUPERSLAB_MASK) == (size_t)this;
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Plain-data snapshot of the allocator statistics.  The layout is fixed so
+ * that it can be used from C, and filling it neither allocates nor takes a
+ * lock, so it can be called from a signal handler or from inside `malloc`.
+ */
+
+#define SNMALLOC_STATS_SIZECLASSES 128
+#define SNMALLOC_STATS_LARGE_CLASSES 64
+
+typedef struct snmalloc_sizeclass_stats
+{
+  // Size of objects in this class.
+  size_t size;
+  size_t allocs;
+  size_t frees;
+  // Slabs in use, for small classes only.
+  size_t slabs;
+} snmalloc_sizeclass_stats_t;
+
+typedef struct snmalloc_stats
+{
+  // Allocators ever created, including ones not currently owned by a thread.
+  size_t allocators;
+  // Bytes of address space reserved from the platform.
+  size_t reserved;
+  // Bytes held as superslabs, medium slabs and large objects.
+  size_t committed;
+  // Bytes in live objects, rounded up to their sizeclass.
+  size_t allocated;
+  size_t remote_frees;
+  size_t remote_receives;
+  // Number of valid entries in each of the arrays below.
+  size_t sizeclasses;
+  size_t large_classes;
+  snmalloc_sizeclass_stats_t sizeclass[SNMALLOC_STATS_SIZECLASSES];
+  snmalloc_sizeclass_stats_t large[SNMALLOC_STATS_LARGE_CLASSES];
+} snmalloc_stats_t;
+
+#ifdef __cplusplus
+#  include "../ds/fdwriter.h"
+#  include "globalalloc.h"
+
+#  include <string.h>
+
+namespace snmalloc
+{
+  static_assert(
+    NUM_SIZECLASSES <= SNMALLOC_STATS_SIZECLASSES,
+    "snmalloc_stats_t is too small for the number of sizeclasses");
+  static_assert(
+    NUM_LARGE_CLASSES <= SNMALLOC_STATS_LARGE_CLASSES,
+    "snmalloc_stats_t is too small for the number of large classes");
+
+  /**
+   * Fill `s` by summing the always-on counters of every allocator in the
+   * pool.  Other threads may be allocating while this runs, so the result
+   * is approximate, and `frees` may briefly run ahead of `allocs`.  Before
+   * the first allocation there is no pool, and every count is zero.
+   */
+  inline void stats_snapshot(snmalloc_stats_t* s)
+  {
+    memset(s, 0, sizeof(snmalloc_stats_t));
+    s->sizeclasses = NUM_SIZECLASSES;
+    s->large_classes = NUM_LARGE_CLASSES;
+
+    for (size_t i = 0; i < NUM_SIZECLASSES; i++)
+      s->sizeclass[i].size = sizeclass_to_size((uint8_t)i);
+
+    for (size_t i = 0; i < NUM_LARGE_CLASSES; i++)
+      s->large[i].size = large_sizeclass_to_size((uint8_t)i);
+
+    // Creating the pool would reserve memory and read the environment.
+    auto* pool = existing_alloc_pool();
+
+    if (pool == nullptr)
+      return;
+
+    // Only the sum of `committed` over all allocators is non-negative.
+    ptrdiff_t committed = 0;
+
+    for (Alloc* a = pool->iterate(); a != nullptr; a = pool->iterate(a))
+    {
+      Stats& stats = a->stats();
+      s->allocators++;
+      s->reserved += stats.reserved;
+      committed += stats.committed;
+      s->remote_frees += stats.remote_frees;
+      s->remote_receives += stats.remote_receives;
+
+      for (size_t i = 0; i < NUM_SIZECLASSES; i++)
+      {
+        auto& c = stats.sizeclass_counters[i];
+        s->sizeclass[i].allocs += c.allocs;
+        s->sizeclass[i].frees += c.frees;
+        s->sizeclass[i].slabs += c.slabs;
+      }
+
+      for (size_t i = 0; i < NUM_LARGE_CLASSES; i++)
+      {
+        auto& c = stats.large_counters[i];
+        s->large[i].allocs += c.allocs;
+        s->large[i].frees += c.frees;
+      }
+    }
+
+    s->committed = committed < 0 ? 0 : (size_t)committed;
+
+    for (size_t i = 0; i < NUM_SIZECLASSES; i++)
+    {
+      auto& c = s->sizeclass[i];
+      if (c.allocs > c.frees)
+        s->allocated += (c.allocs - c.frees) * c.size;
+    }
+
+    for (size_t i = 0; i < NUM_LARGE_CLASSES; i++)
+    {
+      auto& c = s->large[i];
+      if (c.allocs > c.frees)
+        s->allocated += (c.allocs - c.frees) * c.size;
+    }
+  }
+
+  /**
+   * Write a snapshot to `fd` as CSV: the totals, then one row for each
+   * sizeclass and large class that has been used.
+   */
+  inline void stats_print(int fd)
+  {
+    snmalloc_stats_t s;
+    stats_snapshot(&s);
+    FdWriter out(fd);
+
+    out << "allocators, " << s.allocators << '\n'
+        << "reserved, " << s.reserved << '\n'
+        << "committed, " << s.committed << '\n'
+        << "allocated, " << s.allocated << '\n'
+        << "remote_frees, " << s.remote_frees << '\n'
+        << "remote_receives, " << s.remote_receives << '\n';
+
+    out << "sizeclass, size, allocs, frees, slabs\n";
+    for (size_t i = 0; i < s.sizeclasses; i++)
+    {
+      auto& c = s.sizeclass[i];
+      if (c.allocs != 0)
+        out << i << ", " << c.size << ", " << c.allocs << ", " << c.frees
+            << ", " << c.slabs << '\n';
+    }
+
+    out << "large, size, allocs, frees\n";
+    for (size_t i = 0; i < s.large_classes; i++)
+    {
+      auto& c = s.large[i];
+      if (c.allocs != 0)
+        out << i << ", " << c.size << ", " << c.allocs << ", " << c.frees
+            << '\n';
+    }
+  }
+}
+#endif
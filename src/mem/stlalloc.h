@@ -0,0 +1,193 @@
+#pragma once
+
+#include "threadalloc.h"
+
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#if __has_include(<memory_resource>)
+#  include <memory_resource>
+#endif
+
+namespace snmalloc
+{
+  /**
+   * The allocator used by the adaptors below.  With a `Backend` of `void`,
+   * this is the current thread's allocator.  Otherwise, it is a specific
+   * instance of `Backend`, such as an `Alloc` or a `Heap`.
+   */
+  template<class Backend>
+  class STLBackend
+  {
+    Backend* backend;
+
+  public:
+    STLBackend(Backend* b) : backend(b) {}
+
+    Backend* get_backend() const
+    {
+      return backend;
+    }
+
+    Backend* get() const
+    {
+      return backend;
+    }
+  };
+
+  template<>
+  class STLBackend<void>
+  {
+  public:
+    void* get_backend() const
+    {
+      return nullptr;
+    }
+
+    static auto get()
+    {
+      return ThreadAlloc::get();
+    }
+  };
+
+  /**
+   * Allocator for standard library containers.  Unlike going through the
+   * global `operator new`, requests for a single object, which is what
+   * node-based containers make, use the statically sized allocation and
+   * deallocation paths, and no request needs a pagemap lookup.
+   */
+  template<class T, class Backend = void>
+  class STLAllocator : public STLBackend<Backend>
+  {
+    static_assert(
+      alignof(T) <= MIN_ALLOC_SIZE,
+      "STLAllocator does not support over-aligned types");
+
+    static size_t request_size(size_t size)
+    {
+      // Include size 0 in the first sizeclass.
+      return ((size - 1) >> (bits::BITS - 1)) + size;
+    }
+
+  public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::is_void<Backend>;
+
+    template<class U>
+    struct rebind
+    {
+      using other = STLAllocator<U, Backend>;
+    };
+
+    STLAllocator() = default;
+
+    /**
+     * Construct an allocator that uses a specific instance of `Backend`.
+     */
+    template<
+      class B = Backend,
+      typename = std::enable_if_t<!std::is_void_v<B>>>
+    STLAllocator(B* b) : STLBackend<Backend>(b)
+    {}
+
+    template<class U>
+    STLAllocator(const STLAllocator<U, Backend>& other)
+    : STLBackend<Backend>(other)
+    {}
+
+    T* allocate(size_t n)
+    {
+      if (n == 1)
+        return (T*)this->get()->template alloc<sizeof(T)>();
+
+      bool overflow = false;
+      size_t size = bits::umul(sizeof(T), n, overflow);
+
+      if (overflow)
+        throw std::bad_array_new_length();
+
+      return (T*)this->get()->alloc(request_size(size));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+      if (n == 1)
+        this->get()->template dealloc<sizeof(T)>(p);
+      else
+        this->get()->dealloc(p, request_size(sizeof(T) * n));
+    }
+
+    template<class U>
+    bool operator==(const STLAllocator<U, Backend>& other) const
+    {
+      return this->get_backend() == other.get_backend();
+    }
+
+    template<class U>
+    bool operator!=(const STLAllocator<U, Backend>& other) const
+    {
+      return !(*this == other);
+    }
+  };
+
+#if __has_include(<memory_resource>)
+  /**
+   * A `std::pmr::memory_resource` that allocates from snmalloc.  Requests
+   * are rounded up to the smallest size whose objects are all aligned as
+   * requested, as given by `aligned_size`.  As the standard requires, an
+   * alignment that no size satisfies throws `std::bad_alloc`.
+   */
+  template<class Backend = void>
+  class MemoryResource : public std::pmr::memory_resource,
+                         public STLBackend<Backend>
+  {
+    static size_t request_size(size_t bytes, size_t alignment)
+    {
+      // Include size 0 in the first sizeclass.
+      bytes = ((bytes - 1) >> (bits::BITS - 1)) + bytes;
+
+      return aligned_size(alignment, bytes);
+    }
+
+  public:
+    MemoryResource() = default;
+
+    /**
+     * Construct a memory resource that uses a specific instance of `Backend`.
+     */
+    template<
+      class B = Backend,
+      typename = std::enable_if_t<!std::is_void_v<B>>>
+    MemoryResource(B* b) : STLBackend<Backend>(b)
+    {}
+
+  protected:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+      size_t size = request_size(bytes, alignment);
+
+      if (size == 0)
+        throw std::bad_alloc();
+
+      return this->get()->alloc(size);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override
+    {
+      // Only sizes that `do_allocate` accepted can be freed.
+      assert(request_size(bytes, alignment) != 0);
+      this->get()->dealloc(p, request_size(bytes, alignment));
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const
+      noexcept override
+    {
+      auto* o = dynamic_cast<const MemoryResource*>(&other);
+      return (o != nullptr) && (o->get_backend() == this->get_backend());
+    }
+  };
+#endif
+}
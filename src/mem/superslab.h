@@ -153,6 +153,9 @@ namespace snmalloc
       meta[0].head = get_slab_offset(sizeclass, true);
       meta[0].sizeclass = sizeclass;
       meta[0].link = SLABLINK_INDEX;
+#ifdef USE_SLAB_REMOTE_FREE
+      meta[0].init_remote();
+#endif
 
       if (decommit_strategy == DecommitAll)
       {
@@ -174,6 +177,9 @@ namespace snmalloc
       meta[head].head = get_slab_offset(sizeclass, false);
       meta[head].sizeclass = sizeclass;
       meta[head].link = SLABLINK_INDEX;
+#ifdef USE_SLAB_REMOTE_FREE
+      meta[head].init_remote();
+#endif
 
       head = head + n + 1;
       used += 2;
@@ -2,6 +2,25 @@
 
 #include "../ds/helpers.h"
 #include "globalalloc.h"
+
+#if defined(__linux__) && !defined(OPEN_ENCLAVE)
+#  if __has_include(<sys/rseq.h>)
+#    include <sys/rseq.h>
+#  endif
+#endif
+
+/**
+ * When snmalloc is loaded with `LD_PRELOAD` it is part of the initial set of
+ * modules, so its thread-local variables can use the initial-exec model.  This
+ * avoids a call to `__tls_get_addr` on every access, but a library built this
+ * way cannot be loaded with `dlopen`.
+ */
+#if defined(SNMALLOC_USE_INITIAL_EXEC_TLS) && !defined(_MSC_VER)
+#  define SNMALLOC_TLS_MODEL __attribute__((tls_model("initial-exec")))
+#else
+#  define SNMALLOC_TLS_MODEL
+#endif
+
 #if defined(SNMALLOC_USE_THREAD_DESTRUCTOR) && \
   defined(SNMALLOC_USE_THREAD_CLEANUP)
 #error At most one out of SNMALLOC_USE_THREAD_CLEANUP and SNMALLOC_USE_THREAD_DESTRUCTOR may be defined.
@@ -215,6 +234,27 @@ namespace snmalloc
       pthread_setspecific(key, static_cast<void*>(value));
     }
 #  endif
+
+    /**
+     * Slow path for `get`, called only the first time that a thread
+     * allocates.  This is kept out of line so that the inlined fast path is a
+     * single thread-local load and null check.
+     */
+    static NOINLINE void init(Alloc*& per_thread)
+    {
+      // Construct the allocator and assign it to `per_thread` *before* doing
+      // anything else.  This is important because `tls_key_create` may
+      // allocate memory and if we are providing the `malloc` implementation
+      // then this function must be re-entrant within a single thread.  In
+      // this case, the second call to this function will simply return the
+      // allocator.
+      per_thread = current_alloc_pool()->acquire();
+
+      tls_key_t key = Singleton<tls_key_t, tls_key_create>::get();
+      // Associate the new allocator with the destructor.
+      tls_set_value(key, &per_thread);
+    }
+
   public:
     /**
      * Public interface, returns the allocator for the current thread,
@@ -222,25 +262,325 @@ namespace snmalloc
      */
     static inline Alloc*& get()
     {
-      static thread_local Alloc* per_thread;
+      static thread_local Alloc* per_thread SNMALLOC_TLS_MODEL;
 
       // If we don't have an allocator, construct one.
-      if (!per_thread)
+      if (per_thread == nullptr)
+        init(per_thread);
+
+      return per_thread;
+    }
+  };
+#endif
+
+#if defined(__linux__) && !defined(OPEN_ENCLAVE)
+#  ifndef SNMALLOC_MAX_CPUS
+#    define SNMALLOC_MAX_CPUS 1024
+#  endif
+#  if __has_include(<sys/rseq.h>) && \
+    (defined(__x86_64__) || defined(__aarch64__))
+#    define SNMALLOC_PER_CPU_RSEQ
+#  endif
+  /**
+   * Version of the `ThreadAlloc` interface that shares one allocator between
+   * all of the threads running on a CPU, rather than giving each thread its
+   * own.  This bounds the number of allocators by the number of CPUs, which
+   * matters for processes with many mostly-idle threads.
+   *
+   * A thread takes the allocator for its CPU with a restartable sequence
+   * (`rseq`), which stores the thread's token in the CPU's slot only if the
+   * slot is free and the thread is still on that CPU.  The kernel restarts
+   * the sequence if the thread is preempted, migrated or signalled part way
+   * through, so no two threads can take the same slot, and the fast path has
+   * no atomic read-modify-write.  The slot is released with a plain store
+   * when the handle returned by `get` is destroyed.
+   *
+   * A thread that finds its CPU's slot taken, because the owner was
+   * preempted while using the allocator, borrows an allocator from the pool
+   * for the duration of the handle rather than waiting.  Allocators are only
+   * ever acquired from the pool with no slot held, and borrowed allocators
+   * go back to the pool, so the number of allocators stays close to the
+   * number of CPUs.  A re-entrant call on a thread that already holds an
+   * allocator, for example from a profiler backtrace, reuses that allocator,
+   * exactly as with a per-thread allocator.
+   *
+   * If rseq is not available (old kernel or libc, disabled with
+   * `GLIBC_TUNABLES=glibc.pthread.rseq=0`, or an architecture without a
+   * sequence below), this falls back to the per-thread allocator from
+   * `ThreadAllocExplicitTLSCleanup`.
+   *
+   * `get` returns a handle rather than an `Alloc*`.  Callers that keep the
+   * allocator across several calls must hold the handle itself, for example
+   * `auto a = ThreadAlloc::get();`, which also works with every other
+   * policy.
+   */
+  class ThreadAllocPerCPU
+  {
+    /**
+     * Per-CPU state.  Each entry is on its own cache line, as it is written by
+     * every allocation on that CPU.
+     */
+    struct alignas(CACHELINE_SIZE) Slot
+    {
+      /**
+       * Token of the thread using `alloc`, or zero if the slot is free.  This
+       * is only set by a restartable sequence on this slot's CPU, and only
+       * cleared by the thread that set it.
+       */
+      std::atomic<uintptr_t> owner;
+      std::atomic<Alloc*> alloc;
+    };
+
+    /**
+     * The table of per-CPU allocators.  This is a local static, rather than a
+     * global, to allow ODR to deduplicate it.  It is zero initialised, so
+     * every slot starts free and every allocator is created on first use.
+     */
+    static inline Slot* slots()
+    {
+      static Slot table[SNMALLOC_MAX_CPUS];
+      return table;
+    }
+
+    /**
+     * The allocator that this thread holds through a handle, if any.  The
+     * address of this variable is also the thread's token.
+     */
+    static inline Alloc*& held()
+    {
+      static thread_local Alloc* alloc SNMALLOC_TLS_MODEL;
+      return alloc;
+    }
+
+#  ifdef SNMALLOC_PER_CPU_RSEQ
+    static constexpr int Claimed = 0;
+    static constexpr int Busy = 1;
+    static constexpr int Aborted = 2;
+
+    /**
+     * Returns the restartable sequences area that libc registered for this
+     * thread, or `nullptr` if there is none.
+     */
+    static inline volatile struct rseq* rseq_area()
+    {
+      if (__rseq_size == 0)
+        return nullptr;
+
+      void* tp;
+#    if defined(__x86_64__)
+      __asm__("mov %%fs:0, %0" : "=r"(tp));
+#    else
+      tp = __builtin_thread_pointer();
+#    endif
+      auto* rs = (volatile struct rseq*)((char*)tp + __rseq_offset);
+
+      // Negative values mean that registration has not happened or failed.
+      if ((int32_t)rs->cpu_id < 0)
+        return nullptr;
+
+      return rs;
+    }
+
+    /**
+     * Store `token` in `slot->owner` if it is zero, as a restartable
+     * sequence that only commits while the thread is running on `cpu`.  The
+     * sequence descriptor holds absolute addresses, so it lives in a writable
+     * `__rseq_cs` section, in the same group as this function, to avoid text
+     * relocations.  Only the signature and abort handler stay in text.
+     */
+    static inline int
+    claim(volatile struct rseq* rs, Slot* slot, uint32_t cpu, uintptr_t token)
+    {
+      uintptr_t& owner = *(uintptr_t*)&slot->owner;
+
+#    if defined(__x86_64__)
+      __asm__ goto(
+        "leaq 3f(%%rip), %%rax\n"
+        "movq %%rax, %[rseq_cs]\n"
+        "1:\n"
+        "cmpl %[cpu], %[cpu_id]\n"
+        "jnz 4f\n"
+        "cmpq $0, %[owner]\n"
+        "jnz %l[busy]\n"
+        "movq %[token], %[owner]\n"
+        "2:\n"
+        "jmp 5f\n"
+        ".pushsection __rseq_cs, \"aw?\"\n"
+        ".balign 32\n"
+        "3: .long 0x0, 0x0\n"
+        ".quad 1b, (2b - 1b), 4f\n"
+        ".popsection\n"
+        // RSEQ_SIG, which the kernel checks before the abort handler.
+        ".long 0x53053053\n"
+        "4:\n"
+        "jmp %l[aborted]\n"
+        "5:\n"
+        :
+        : [rseq_cs] "m"(rs->rseq_cs),
+          [cpu_id] "m"(rs->cpu_id),
+          [cpu] "r"(cpu),
+          [owner] "m"(owner),
+          [token] "r"(token)
+        : "memory", "cc", "rax"
+        : busy, aborted);
+#    else
+      __asm__ goto(
+        "adrp x9, 3f\n"
+        "add x9, x9, :lo12:3f\n"
+        "str x9, %[rseq_cs]\n"
+        "1:\n"
+        "ldr w9, %[cpu_id]\n"
+        "cmp w9, %w[cpu]\n"
+        "b.ne 4f\n"
+        "ldr x9, %[owner]\n"
+        "cbnz x9, %l[busy]\n"
+        "str %[token], %[owner]\n"
+        "2:\n"
+        "b 5f\n"
+        ".pushsection __rseq_cs, \"aw?\"\n"
+        ".balign 32\n"
+        "3: .long 0x0, 0x0\n"
+        ".quad 1b, (2b - 1b), 4f\n"
+        ".popsection\n"
+        // RSEQ_SIG, which the kernel checks before the abort handler.
+        ".inst 0xd428bc00\n"
+        "4:\n"
+        "b %l[aborted]\n"
+        "5:\n"
+        :
+        : [rseq_cs] "Q"(rs->rseq_cs),
+          [cpu_id] "Q"(rs->cpu_id),
+          [cpu] "r"(cpu),
+          [owner] "Q"(owner),
+          [token] "r"(token)
+        : "memory", "cc", "x9"
+        : busy, aborted);
+#    endif
+      return Claimed;
+    busy:
+      return Busy;
+    aborted:
+      return Aborted;
+    }
+#  endif
+
+    /**
+     * Give `slot` an allocator.  This runs before the slot is claimed, so
+     * that the pool is never entered with a slot held.
+     */
+    static NOINLINE void install(Slot* slot)
+    {
+      Alloc* a = current_alloc_pool()->acquire();
+      Alloc* expected = nullptr;
+
+      if (!slot->alloc.compare_exchange_strong(expected, a))
+        current_alloc_pool()->release(a);
+    }
+
+  public:
+    /**
+     * Exclusive access to an allocator.  The allocator is either this CPU's,
+     * borrowed from the pool, or one that this thread already holds, and it
+     * is given back when the handle is destroyed.
+     */
+    class Handle
+    {
+      Slot* slot;
+      Alloc* alloc;
+      bool borrowed;
+
+    public:
+      Handle(Alloc* a, bool borrowed = false)
+      : slot(nullptr), alloc(a), borrowed(borrowed)
       {
-        // Construct the allocator and assign it to `per_thread` *before* doing
-        // anything else.  This is important because `tls_key_create` may
-        // allocate memory and if we are providing the `malloc` implementation
-        // then this function must be re-entrant within a single thread.  In
-        // this case, the second call to this function will simply return the
-        // allocator.
-        per_thread = current_alloc_pool()->acquire();
+        if (borrowed)
+          held() = alloc;
+      }
 
-        tls_key_t key = Singleton<tls_key_t, tls_key_create>::get();
-        // Associate the new allocator with the destructor.
-        tls_set_value(key, &per_thread);
+      Handle(Slot* s)
+      : slot(s), alloc(s->alloc.load(std::memory_order_relaxed)), borrowed(false)
+      {
+        held() = alloc;
       }
 
-      return per_thread;
+      Handle(const Handle&) = delete;
+      Handle& operator=(const Handle&) = delete;
+
+      ~Handle()
+      {
+        if (slot != nullptr)
+        {
+          held() = nullptr;
+          slot->owner.store(0, std::memory_order_release);
+        }
+        else if (borrowed)
+        {
+          held() = nullptr;
+          current_alloc_pool()->release(alloc);
+        }
+      }
+
+      Alloc* operator->()
+      {
+        return alloc;
+      }
+
+      Alloc& operator*()
+      {
+        return *alloc;
+      }
+    };
+
+    /**
+     * Public interface, returns a handle to the allocator for the current
+     * CPU, constructing it if necessary.
+     */
+    static inline Handle get()
+    {
+      Alloc* a = held();
+
+      if (a != nullptr)
+        return Handle(a);
+
+#  ifdef SNMALLOC_PER_CPU_RSEQ
+      volatile struct rseq* rs = rseq_area();
+
+      if (rs != nullptr)
+      {
+        uintptr_t token = (uintptr_t)&held();
+
+        while (true)
+        {
+          uint32_t cpu = rs->cpu_id_start;
+
+          // A slot must only ever be claimed from one CPU.
+          if (cpu >= SNMALLOC_MAX_CPUS)
+            break;
+
+          Slot* slot = &slots()[cpu];
+
+          if (slot->alloc.load(std::memory_order_acquire) == nullptr)
+            install(slot);
+
+          int r = claim(rs, slot, cpu, token);
+
+          if (r == Claimed)
+          {
+            // Pairs with the release when the previous owner, which may
+            // since have moved to another CPU, gave the slot back.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return Handle(slot);
+          }
+
+          if (r == Busy)
+            break;
+        }
+
+        return Handle(current_alloc_pool()->acquire(), true);
+      }
+#  endif
+
+      return Handle(ThreadAllocExplicitTLSCleanup::get());
     }
   };
 #endif
@@ -259,6 +599,9 @@ namespace snmalloc
   using ThreadAlloc = ThreadAllocThreadDestructor;
 #elif defined(SNMALLOC_EXTERNAL_THREAD_ALLOC)
   using ThreadAlloc = ThreadAllocUntypedWrapper;
+#elif defined(SNMALLOC_USE_PER_CPU) && defined(__linux__) && \
+  !defined(OPEN_ENCLAVE)
+  using ThreadAlloc = ThreadAllocPerCPU;
 #else
   using ThreadAlloc = ThreadAllocExplicitTLSCleanup;
 #endif
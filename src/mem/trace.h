@@ -0,0 +1,221 @@
+#pragma once
+
+#include "threadalloc.h"
+
+#if !defined(_WIN32) && !defined(OPEN_ENCLAVE) && !defined(FreeBSD_KERNEL)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#  define SNMALLOC_TRACE_MMAP
+#endif
+
+namespace snmalloc
+{
+  enum TraceKind : uint32_t
+  {
+    // A slot that was claimed but never completed.
+    TraceNone,
+    TraceMalloc,
+    TraceCalloc,
+    TraceRealloc,
+    TraceFree
+  };
+
+  /**
+   * One allocation event.  Objects are identified by address, so an address
+   * names a new object each time it is returned by an allocation.
+   */
+  struct TraceEvent
+  {
+    // Value of `bits::tick()` when the event was recorded.
+    uint64_t time;
+    // The object allocated or freed.
+    uint64_t object;
+    // For `realloc`, the object that was resized.
+    uint64_t previous;
+    // Requested size, for allocations.
+    uint64_t size;
+    // Small integer identifying the thread, in order of first event.
+    uint32_t thread;
+    // Written last, so that a reader can tell that the event is complete.
+    std::atomic<TraceKind> kind;
+  };
+
+  static_assert(sizeof(TraceEvent) == 40, "Trace file format has changed");
+
+  struct TraceHeader
+  {
+    static constexpr uint64_t MAGIC = 0x65636172746d6e73;
+    static constexpr uint64_t VERSION = 1;
+
+    uint64_t magic;
+    uint64_t version;
+    // Number of event slots in the file.
+    uint64_t capacity;
+    // Number of events recorded, which is more than `capacity` if events
+    // were dropped.
+    std::atomic<uint64_t> count;
+
+    TraceEvent* events()
+    {
+      return (TraceEvent*)bits::align_up((size_t)(this + 1), CACHELINE_SIZE);
+    }
+
+    size_t recorded()
+    {
+      return (std::min)(count.load(std::memory_order_acquire), capacity);
+    }
+
+    static size_t file_size(size_t capacity)
+    {
+      return bits::align_up(sizeof(TraceHeader), CACHELINE_SIZE) +
+        (capacity * sizeof(TraceEvent));
+    }
+  };
+
+  /**
+   * A trace of allocation events, written to a memory-mapped file.  Events
+   * are claimed with a single atomic increment, so the order of events in
+   * the file is the order in which they were recorded.  Allocations must be
+   * recorded after they are made, and frees before they happen, so that an
+   * address is never seen reused before it was freed.
+   *
+   * The file is left at its full size, but only the events that were
+   * recorded take up space on disk.  Once the trace is full, further events
+   * are counted but dropped.
+   */
+  class AllocTrace
+  {
+    TraceHeader* header = nullptr;
+    std::atomic<bool> active{false};
+
+    static uint32_t thread_id()
+    {
+      static std::atomic<uint32_t> next{0};
+      static thread_local uint32_t id SNMALLOC_TLS_MODEL = 0;
+
+      if (id == 0)
+        id = next.fetch_add(1) + 1;
+
+      return id - 1;
+    }
+
+  public:
+    /**
+     * Map `path` and start recording up to `capacity` events.  Returns
+     * false if the file could not be created.
+     */
+    bool open(const char* path, size_t capacity)
+    {
+#ifdef SNMALLOC_TRACE_MMAP
+      size_t size = TraceHeader::file_size(capacity);
+      int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+      if (fd < 0)
+        return false;
+
+      if (ftruncate(fd, (off_t)size) != 0)
+      {
+        ::close(fd);
+        return false;
+      }
+
+      void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      ::close(fd);
+
+      if (p == MAP_FAILED)
+        return false;
+
+      header = (TraceHeader*)p;
+      header->magic = TraceHeader::MAGIC;
+      header->version = TraceHeader::VERSION;
+      header->capacity = capacity;
+      header->count.store(0, std::memory_order_relaxed);
+      active.store(true, std::memory_order_release);
+      return true;
+#else
+      UNUSED(path);
+      UNUSED(capacity);
+      return false;
+#endif
+    }
+
+    /**
+     * Stop recording.  The mapping is kept, as other threads may still be
+     * writing events, and the contents reach the file when the process
+     * exits.
+     */
+    void stop()
+    {
+      active.store(false, std::memory_order_relaxed);
+    }
+
+    bool is_active()
+    {
+      return active.load(std::memory_order_relaxed);
+    }
+
+    void record(
+      TraceKind kind, void* object, size_t size, void* previous = nullptr)
+    {
+      if (!active.load(std::memory_order_acquire))
+        return;
+
+      uint64_t i = header->count.fetch_add(1, std::memory_order_relaxed);
+
+      if (i >= header->capacity)
+        return;
+
+      TraceEvent& e = header->events()[i];
+      e.time = bits::tick();
+      e.object = (uint64_t)object;
+      e.previous = (uint64_t)previous;
+      e.size = size;
+      e.thread = thread_id();
+      e.kind.store(kind, std::memory_order_release);
+    }
+
+    /**
+     * Map an existing trace file for reading.  Returns nullptr if it cannot
+     * be read or is not a trace.
+     */
+    static TraceHeader* read(const char* path)
+    {
+#ifdef SNMALLOC_TRACE_MMAP
+      int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+
+      if (fd < 0)
+        return nullptr;
+
+      off_t size = lseek(fd, 0, SEEK_END);
+      void* p = MAP_FAILED;
+
+      if (size >= (off_t)sizeof(TraceHeader))
+        p = mmap(nullptr, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+
+      ::close(fd);
+
+      if (p == MAP_FAILED)
+        return nullptr;
+
+      TraceHeader* h = (TraceHeader*)p;
+
+      if (
+        (h->magic != TraceHeader::MAGIC) ||
+        (h->version != TraceHeader::VERSION) ||
+        (TraceHeader::file_size(h->capacity) > (size_t)size))
+      {
+        munmap(p, (size_t)size);
+        return nullptr;
+      }
+
+      return h;
+#else
+      UNUSED(path);
+      return nullptr;
+#endif
+    }
+  };
+
+  HEADER_GLOBAL AllocTrace alloc_trace;
+}
@@ -4,6 +4,67 @@
 
 using namespace snmalloc;
 
+namespace
+{
+  /**
+   * Writes statistics to `SNMALLOC_STATS_FILE`, if it was set, when the
+   * process exits.
+   */
+  struct StatsAtExit
+  {
+    ~StatsAtExit()
+    {
+      const char* path = runtime_config.stats_file.load();
+
+      if (path == nullptr)
+        return;
+
+      int fd = FdWriter::open(path);
+
+      if (fd < 0)
+        return;
+
+      stats_print(fd);
+      FdWriter::close(fd);
+    }
+  } stats_at_exit;
+
+  /**
+   * Starts recording allocation events to `SNMALLOC_TRACE_FILE`, if it was
+   * set, when the shim is loaded.
+   */
+  struct TraceAtStart
+  {
+    TraceAtStart()
+    {
+      // Creating the pool reads the environment.
+      current_alloc_pool();
+      const char* path = runtime_config.trace_file.load();
+
+      if (path == nullptr)
+        return;
+
+      if (!alloc_trace.open(path, runtime_config.trace_events.load()))
+      {
+        FdWriter err(2);
+        err << "snmalloc: cannot record trace to " << path << '\n';
+      }
+    }
+
+    ~TraceAtStart()
+    {
+      alloc_trace.stop();
+    }
+  } trace_at_start;
+
+  ALWAYSINLINE void
+  trace(TraceKind kind, void* p, size_t size, void* previous = nullptr)
+  {
+    if (alloc_trace.is_active())
+      alloc_trace.record(kind, p, size, previous);
+  }
+}
+
 #ifndef SNMALLOC_NAME_MANGLE
 #  define SNMALLOC_NAME_MANGLE(a) a
 #endif
@@ -18,9 +79,11 @@ extern "C"
   void* SNMALLOC_NAME_MANGLE(malloc)(size_t size)
   {
     // Include size 0 in the first sizeclass.
-    size = ((size - 1) >> (bits::BITS - 1)) + size;
+    size_t sz = ((size - 1) >> (bits::BITS - 1)) + size;
 
-    return ThreadAlloc::get()->alloc(size);
+    void* p = ThreadAlloc::get()->alloc(sz);
+    trace(TraceMalloc, p, size);
+    return p;
   }
 
   void SNMALLOC_NAME_MANGLE(free)(void* ptr)
@@ -28,6 +91,7 @@ extern "C"
     if (ptr == nullptr)
       return;
 
+    trace(TraceFree, ptr, 0);
     ThreadAlloc::get()->dealloc(ptr);
   }
 
@@ -41,8 +105,10 @@ extern "C"
       return 0;
     }
     // Include size 0 in the first sizeclass.
-    sz = ((sz - 1) >> (bits::BITS - 1)) + sz;
-    return ThreadAlloc::get()->alloc<ZeroMem::YesZero>(sz);
+    size_t rsize = ((sz - 1) >> (bits::BITS - 1)) + sz;
+    void* p = ThreadAlloc::get()->alloc<ZeroMem::YesZero>(rsize);
+    trace(TraceCalloc, p, sz);
+    return p;
   }
 
   size_t SNMALLOC_NAME_MANGLE(malloc_usable_size)(void* ptr)
@@ -75,14 +141,17 @@ extern "C"
         "Calling realloc on pointer that is not to the start of an allocation");
     }
 #endif
-    void* p = SNMALLOC_NAME_MANGLE(malloc)(size);
+    // Record a single event for the move, after the new object exists and
+    // before the old one can be reused.
+    void* p = ThreadAlloc::get()->alloc(size);
     if (p)
     {
       assert(p == Alloc::external_pointer<Start>(p));
       size_t sz =
         (std::min)(size, SNMALLOC_NAME_MANGLE(malloc_usable_size)(ptr));
       memcpy(p, ptr, sz);
-      SNMALLOC_NAME_MANGLE(free)(ptr);
+      trace(TraceRealloc, p, size, ptr);
+      ThreadAlloc::get()->dealloc(ptr);
     }
     return p;
   }
@@ -123,22 +192,13 @@ extern "C"
       return nullptr;
     }
 
-    uint8_t sc = size_to_sizeclass((std::max)(size, alignment));
-    if (sc >= NUM_SIZECLASSES)
-    {
-      // large allocs are 16M aligned.
-      return SNMALLOC_NAME_MANGLE(malloc)(size);
-    }
-    for (; sc < NUM_SIZECLASSES; sc++)
+    size = aligned_size(alignment, size);
+    if (size == 0)
     {
-      size = sizeclass_to_size(sc);
-      if ((size & -size) >= alignment)
-      {
-        return SNMALLOC_NAME_MANGLE(aligned_alloc)(alignment, size);
-      }
+      errno = ENOMEM;
+      return nullptr;
     }
-    assert(false);
-    return nullptr;
+    return SNMALLOC_NAME_MANGLE(malloc)(size);
   }
 
   int SNMALLOC_NAME_MANGLE(posix_memalign)(
@@ -178,11 +238,81 @@ extern "C"
       OS_PAGE_SIZE, (size + OS_PAGE_SIZE - 1) & ~(OS_PAGE_SIZE - 1));
   }
 
+  size_t SNMALLOC_NAME_MANGLE(snmalloc_good_size)(size_t size)
+  {
+    return round_size(size);
+  }
+
+  /**
+   * Size of the allocation that `mallocx(size, flags)` would return.  Only
+   * the alignment flag, `MALLOCX_LG_ALIGN(la)`, is used; it is stored in the
+   * low six bits of `flags`.
+   */
+  size_t SNMALLOC_NAME_MANGLE(nallocx)(size_t size, int flags)
+  {
+    size_t alignment = (size_t)1 << (flags & 0x3f);
+
+    if (alignment <= MIN_ALLOC_SIZE)
+      return round_size(size);
+
+    return aligned_size(alignment, size);
+  }
+
   void SNMALLOC_NAME_MANGLE(_malloc_prefork)(void) {}
   void SNMALLOC_NAME_MANGLE(_malloc_postfork)(void) {}
   void SNMALLOC_NAME_MANGLE(_malloc_first_thread)(void) {}
-  int SNMALLOC_NAME_MANGLE(mallctl)(const char*, void*, size_t*, void*, size_t)
+  int SNMALLOC_NAME_MANGLE(mallctl)(
+    const char* name, void* oldp, size_t* oldlenp, void* newp, size_t newlen)
+  {
+    return MallCtl::ctl(name, oldp, oldlenp, newp, newlen);
+  }
+
+  /**
+   * Fill `stats`, which is `size` bytes long, with a snapshot of the
+   * allocator statistics.  Safe to call from a signal handler.
+   */
+  int SNMALLOC_NAME_MANGLE(snmalloc_stats)(snmalloc_stats_t* stats, size_t size)
+  {
+    if (size != sizeof(snmalloc_stats_t))
+      return EINVAL;
+
+    stats_snapshot(stats);
+    return 0;
+  }
+
+  /**
+   * Write a report of slab occupancy by sizeclass to `fd`.
+   */
+  void SNMALLOC_NAME_MANGLE(snmalloc_fragmentation)(int fd)
+  {
+    FragmentationReport report;
+    report.collect();
+    report.print(fd);
+  }
+
+  void* SNMALLOC_NAME_MANGLE(snmalloc_heap_create)(void)
+  {
+    return Heap::create();
+  }
+
+  void* SNMALLOC_NAME_MANGLE(snmalloc_heap_alloc)(void* heap, size_t size)
+  {
+    // Include size 0 in the first sizeclass.
+    size = ((size - 1) >> (bits::BITS - 1)) + size;
+
+    return static_cast<Heap*>(heap)->alloc(size);
+  }
+
+  void SNMALLOC_NAME_MANGLE(snmalloc_heap_free)(void* heap, void* ptr)
+  {
+    if (ptr == nullptr)
+      return;
+
+    static_cast<Heap*>(heap)->dealloc(ptr);
+  }
+
+  void SNMALLOC_NAME_MANGLE(snmalloc_heap_destroy)(void* heap)
   {
-    return ENOENT;
+    static_cast<Heap*>(heap)->destroy();
   }
 }
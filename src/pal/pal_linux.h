@@ -86,8 +86,21 @@ namespace snmalloc
         munmap((void*)end, (p0 + request) - end);
         p = (void*)start;
       }
+
       return p;
     }
+
+    /// Ask the platform to use, or to avoid, huge pages for these pages
+    void notify_huge_pages(void* p, size_t size, bool huge) noexcept
+    {
+#  ifdef MADV_HUGEPAGE
+      madvise(p, size, huge ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#  else
+      UNUSED(p);
+      UNUSED(size);
+      UNUSED(huge);
+#  endif
+    }
   };
 }
 #endif
@@ -1,3 +1,10 @@
 #pragma once
 
 #include "mem/threadalloc.h"
+#include "mem/arena.h"
+#include "mem/fragmentation.h"
+#include "mem/heap.h"
+#include "mem/mallctl.h"
+#include "mem/stlalloc.h"
+#include "mem/statssnapshot.h"
+#include "mem/trace.h"
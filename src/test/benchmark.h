@@ -0,0 +1,236 @@
+#pragma once
+
+#include "opt.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(_WIN32)
+#  define WIN32_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <windows.h>
+#elif defined(__linux__)
+#  include <sched.h>
+#endif
+
+namespace benchmark
+{
+  enum Format
+  {
+    Text,
+    JSON,
+    CSV
+  };
+
+  struct Result
+  {
+    size_t repeats;
+    double min;
+    double p10;
+    double median;
+    double p90;
+    double max;
+    double mean;
+    double stddev;
+    // Half-width of the 95% confidence interval for the mean.
+    double ci95;
+  };
+
+  /**
+   * Runs timed sections of a benchmark.  Each section is run `--warmup`
+   * times untimed and then `--repeat` times timed, and the distribution of
+   * the timings is reported, in nanoseconds, as text or, with
+   * `--format=json` or `--format=csv`, as one record per section.
+   *
+   * `--cpu=n` pins the calling thread to CPU `n` before anything is timed.
+   * Threads created by the benchmark inherit this, so it is only useful for
+   * single-threaded benchmarks.
+   */
+  class Harness
+  {
+    size_t warmup;
+    size_t repeats;
+    Format format = Text;
+    bool header = false;
+
+    static double percentile(std::vector<double>& sorted, size_t p)
+    {
+      double rank = ((double)(sorted.size() - 1) * (double)p) / 100;
+      size_t lo = (size_t)rank;
+      size_t hi = (std::min)(lo + 1, sorted.size() - 1);
+      double frac = rank - (double)lo;
+      return (sorted[lo] * (1 - frac)) + (sorted[hi] * frac);
+    }
+
+    /**
+     * Two-sided 95% critical value of Student's t distribution.
+     */
+    static double t95(size_t degrees)
+    {
+      static constexpr double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+
+      if (degrees == 0)
+        return 0;
+
+      if (degrees <= sizeof(table) / sizeof(table[0]))
+        return table[degrees - 1];
+
+      return 1.960;
+    }
+
+    static void pin(size_t cpu)
+    {
+#if defined(_WIN32)
+      SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+#elif defined(__linux__)
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+      sched_setaffinity(0, sizeof(set), &set);
+#else
+      (void)cpu;
+#endif
+    }
+
+    void print(const std::string& name, Result& r)
+    {
+      // Nanosecond resolution is more than enough for any of these.
+      uint64_t v[] = {(uint64_t)r.min,
+                      (uint64_t)r.p10,
+                      (uint64_t)r.median,
+                      (uint64_t)r.p90,
+                      (uint64_t)r.max,
+                      (uint64_t)r.mean,
+                      (uint64_t)r.stddev,
+                      (uint64_t)r.ci95};
+      const char* fields[] = {
+        "min", "p10", "median", "p90", "max", "mean", "stddev", "ci95"};
+
+      switch (format)
+      {
+        case Text:
+          std::cout << name << ": median " << std::setw(12) << v[2]
+                    << " ns (p10 " << v[1] << ", p90 " << v[3] << "), mean "
+                    << v[5] << " +- " << v[7] << " ns, " << r.repeats
+                    << " runs" << std::endl;
+          break;
+
+        case JSON:
+          std::cout << "{\"name\": \"" << name << "\", \"repeats\": "
+                    << r.repeats;
+          for (size_t i = 0; i < 8; i++)
+            std::cout << ", \"" << fields[i] << "\": " << v[i];
+          std::cout << "}" << std::endl;
+          break;
+
+        case CSV:
+          if (!header)
+          {
+            std::cout << "name, repeats";
+            for (size_t i = 0; i < 8; i++)
+              std::cout << ", " << fields[i];
+            std::cout << std::endl;
+            header = true;
+          }
+
+          std::cout << "\"" << name << "\", " << r.repeats;
+          for (size_t i = 0; i < 8; i++)
+            std::cout << ", " << v[i];
+          std::cout << std::endl;
+          break;
+      }
+    }
+
+  public:
+    Harness(opt::Opt& opt, size_t default_repeats = 10)
+    {
+#ifdef NDEBUG
+      warmup = opt.is<size_t>("--warmup", 1);
+#else
+      // Debug timings are not worth repeating by default; running once
+      // checks that the benchmark works.
+      warmup = opt.is<size_t>("--warmup", 0);
+      default_repeats = 1;
+#endif
+      repeats =
+        (std::max)(opt.is<size_t>("--repeat", default_repeats), (size_t)1);
+
+      std::string f = opt.is("--format", "text");
+      if (f == "json")
+        format = JSON;
+      else if (f == "csv")
+        format = CSV;
+
+      size_t cpu = opt.is<size_t>("--cpu", ~(size_t)0);
+      if (cpu != ~(size_t)0)
+        pin(cpu);
+    }
+
+    /**
+     * Time `body`, reporting the result under `name`.  If `body` returns a
+     * `std::chrono::nanoseconds`, that is used as the time of the run, so
+     * that a benchmark can leave its setup and teardown out of the timing.
+     */
+    template<typename F>
+    Result run(const std::string& name, F body)
+    {
+      std::vector<double> times;
+      times.reserve(repeats);
+
+      for (size_t i = 0; i < warmup; i++)
+        body();
+
+      for (size_t i = 0; i < repeats; i++)
+      {
+        std::chrono::nanoseconds time;
+
+        if constexpr (std::is_void_v<decltype(body())>)
+        {
+          auto start = std::chrono::steady_clock::now();
+          body();
+          time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+        }
+        else
+        {
+          time = body();
+        }
+
+        times.push_back((double)time.count());
+      }
+
+      std::sort(times.begin(), times.end());
+
+      Result r;
+      r.repeats = repeats;
+      r.min = times.front();
+      r.max = times.back();
+      r.p10 = percentile(times, 10);
+      r.median = percentile(times, 50);
+      r.p90 = percentile(times, 90);
+
+      double sum = 0;
+      for (double t : times)
+        sum += t;
+      r.mean = sum / (double)repeats;
+
+      double squares = 0;
+      for (double t : times)
+        squares += (t - r.mean) * (t - r.mean);
+      r.stddev = repeats > 1 ? std::sqrt(squares / (double)(repeats - 1)) : 0;
+      r.ci95 = t95(repeats - 1) * r.stddev / std::sqrt((double)repeats);
+
+      print(name, r);
+      return r;
+    }
+  };
+}
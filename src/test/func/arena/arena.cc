@@ -0,0 +1,77 @@
+#include <snmalloc.h>
+#include <test/xoroshiro.h>
+
+using namespace snmalloc;
+
+void check_object(void* p, size_t size)
+{
+  if (Alloc::alloc_size(p) != size)
+    abort();
+
+  for (size_t offset = 0; offset < size; offset += 1 + (size / 8))
+  {
+    void* interior = (void*)((size_t)p + offset);
+
+    if (Alloc::external_pointer<Start>(interior) != p)
+      abort();
+
+    if ((size_t)Alloc::external_pointer<End>(interior) != (size_t)p + size - 1)
+      abort();
+  }
+}
+
+void test_arena()
+{
+  constexpr size_t count = 1 << 16;
+  xoroshiro::p128r32 r;
+  auto alloc = ThreadAlloc::get();
+  void** objects = (void**)alloc->alloc(count * sizeof(void*));
+  size_t* sizes = (size_t*)alloc->alloc(count * sizeof(size_t));
+
+  Arena<> arena;
+  void* first = nullptr;
+
+  for (size_t round = 0; round < 3; round++)
+  {
+    // Enough to need several chunks.
+    for (size_t i = 0; i < count; i++)
+    {
+      sizes[i] = 1 + (r.next() % 1024);
+      objects[i] = arena.alloc(sizes[i]);
+      sizes[i] = bits::align_up(sizes[i], MIN_ALLOC_SIZE);
+      memset(objects[i], 0xAB, sizes[i]);
+    }
+
+    // `reset` rewinds to the same memory.
+    if (round == 0)
+      first = objects[0];
+    else if (objects[0] != first)
+      abort();
+
+    for (size_t i = 0; i < count; i++)
+      check_object(objects[i], sizes[i]);
+
+    size_t large_size = SUPERSLAB_SIZE * 2;
+    void* large = arena.alloc<YesZero>(large_size);
+    check_object(large, large_size);
+
+    arena.reset();
+  }
+
+  arena.release();
+
+  if (global_pagemap.get(first) != 0)
+    abort();
+
+  alloc->dealloc(sizes, count * sizeof(size_t));
+  alloc->dealloc(objects, count * sizeof(void*));
+}
+
+int main(int argc, char** argv)
+{
+  UNUSED(argc);
+  UNUSED(argv);
+
+  test_arena();
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include <snmalloc.h>
+#include <stdlib.h>
+
+using namespace snmalloc;
+
+void set(const char* name, const char* value)
+{
+#ifdef _WIN32
+  _putenv_s(name, value);
+#else
+  setenv(name, value, 1);
+#endif
+}
+
+void test_env()
+{
+  auto& c = runtime_config;
+  size_t cache = c.remote_cache;
+  size_t batch = c.remote_batch;
+  size_t objects = c.remote_cache_objects;
+  size_t ticks = c.remote_cache_ticks;
+  size_t reserve = c.reserve_multiple;
+  DecommitStrategy decommit = chunk_decommit_strategy;
+  const char* names[] = {"none", "super", "all"};
+
+  set("SNMALLOC_REMOTE_CACHE", "2m");
+  set("SNMALLOC_REMOTE_CACHE_OBJECTS", "0");
+  set("SNMALLOC_REMOTE_CACHE_TICKS", "0");
+  set("SNMALLOC_REMOTE_BATCH", "0");
+  set("SNMALLOC_RESERVE_SIZE", "64x");
+  set("SNMALLOC_THP", "never");
+  set("SNMALLOC_DECOMMIT", names[decommit]);
+  EnvConfig::read();
+
+  if ((c.remote_cache != (2 << 20)) || (c.remote_cache_ticks != 0))
+    abort();
+
+  // Out of range and malformed values are ignored.
+  if ((c.remote_batch != batch) || (c.reserve_multiple != reserve))
+    abort();
+
+  if (c.remote_cache_objects != objects)
+    abort();
+
+  if (
+    (c.huge_pages != HugePagesNever) || (chunk_decommit_strategy != decommit))
+    abort();
+
+  set("SNMALLOC_REMOTE_BATCH", "17");
+  set("SNMALLOC_THP", "sometimes");
+  // Whether single slabs are decommitted is fixed at compile time.
+  set("SNMALLOC_DECOMMIT", decommit_strategy == DecommitAll ? "super" : "all");
+  EnvConfig::read();
+
+  if (chunk_decommit_strategy != decommit)
+    abort();
+
+  if ((c.remote_batch != 17) || (c.huge_pages != HugePagesNever))
+    abort();
+
+  // Memory reserved with huge pages turned off is still usable.
+  auto alloc = ThreadAlloc::get();
+  void* p = alloc->alloc(SUPERSLAB_SIZE * 4);
+  memset(p, 1, SUPERSLAB_SIZE * 4);
+  alloc->dealloc(p);
+
+  c.remote_cache = cache;
+  c.remote_batch = batch;
+  c.remote_cache_ticks = ticks;
+  c.huge_pages = HugePagesDefault;
+}
+
+int main(int argc, char** argv)
+{
+  UNUSED(argc);
+  UNUSED(argv);
+
+  test_env();
+  return 0;
+}
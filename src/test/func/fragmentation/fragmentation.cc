@@ -0,0 +1,82 @@
+#include <snmalloc.h>
+
+using namespace snmalloc;
+
+void test_fragmentation()
+{
+  constexpr size_t count = 1 << 16;
+  constexpr size_t size = 48;
+  constexpr size_t keep = 50;
+  uint8_t sc = size_to_sizeclass(size);
+
+  auto* alloc = current_alloc_pool()->acquire();
+  void** objects = (void**)alloc->alloc(count * sizeof(void*));
+
+  // Not allocated, so that it does not occupy a slab itself.
+  static FragmentationReport r;
+  FragmentationReport* report = &r;
+  report->collect();
+  size_t objects_before = report->sizeclass[sc].objects;
+
+  for (size_t i = 0; i < count; i++)
+    objects[i] = alloc->alloc(size);
+
+  report->collect();
+
+  if (report->sizeclass[sc].objects != objects_before + count)
+    abort();
+  if (report->sizeclass[sc].full_slabs == 0)
+    abort();
+
+  // Keep one object in every `keep`, which leaves slabs nearly empty.
+  for (size_t i = 0; i < count; i++)
+  {
+    if ((i % keep) != 0)
+    {
+      alloc->dealloc(objects[i]);
+      objects[i] = nullptr;
+    }
+  }
+
+  report->collect();
+
+  auto& s = report->sizeclass[sc];
+  if (s.objects != objects_before + ((count + keep - 1) / keep))
+    abort();
+  if (s.sparse_slabs == 0)
+    abort();
+  if (report->pinned_superslabs == 0)
+    abort();
+
+  size_t total = 0;
+  for (size_t i = 0; i < FragmentationReport::OCCUPANCY_BUCKETS; i++)
+    total += s.occupancy[i];
+  if (total != s.slabs)
+    abort();
+
+  // Medium slabs are reported by their free count.
+  void* medium = alloc->alloc(SLAB_SIZE * 2);
+  report->collect();
+  uint8_t msc = size_to_sizeclass(SLAB_SIZE * 2);
+  if (report->sizeclass[msc].objects == 0)
+    abort();
+  alloc->dealloc(medium);
+
+  for (size_t i = 0; i < count; i++)
+  {
+    if (objects[i] != nullptr)
+      alloc->dealloc(objects[i]);
+  }
+
+  alloc->dealloc(objects);
+  current_alloc_pool()->release(alloc);
+}
+
+int main(int argc, char** argv)
+{
+  UNUSED(argc);
+  UNUSED(argv);
+
+  test_fragmentation();
+  return 0;
+}
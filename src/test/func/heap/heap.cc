@@ -0,0 +1,84 @@
+#include <snmalloc.h>
+#include <test/xoroshiro.h>
+
+using namespace snmalloc;
+
+constexpr size_t count = 1 << 14;
+
+void fill(Heap* heap, void** objects, xoroshiro::p128r32& r)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    size_t size = 16 + (r.next() % 2048);
+    objects[i] = heap->alloc(size);
+    memset(objects[i], 0xAB, size);
+  }
+}
+
+void test_destroy()
+{
+  xoroshiro::p128r32 r;
+  auto alloc = ThreadAlloc::get();
+  void** objects = (void**)alloc->alloc(count * sizeof(void*));
+
+  Heap* heap = Heap::create();
+  fill(heap, objects, r);
+
+  // Free some of the objects, leaving the rest for `destroy`.
+  for (size_t i = 0; i < count; i += 4)
+  {
+    heap->dealloc(objects[i]);
+    objects[i] = nullptr;
+  }
+
+  void* medium = heap->alloc(256 * 1024);
+  void* large = heap->alloc(SUPERSLAB_SIZE * 2);
+  memset(large, 0xCD, SUPERSLAB_SIZE * 2);
+
+  // Objects from the thread's allocator freed through the heap are
+  // forwarded when the heap is destroyed.
+  void* foreign = alloc->alloc(48);
+  heap->dealloc(foreign);
+
+  heap->destroy();
+
+  for (size_t i = 0; i < count; i++)
+  {
+    if ((objects[i] != nullptr) && (global_pagemap.get(objects[i]) != 0))
+      abort();
+  }
+
+  if (global_pagemap.get(medium) != 0)
+    abort();
+
+  if (global_pagemap.get(large) != 0)
+    abort();
+
+  // The address space of the heap is available to every allocator.
+  Largeslab* slab = default_memory_provider.large_stack[0].pop();
+  if (slab == nullptr)
+    abort();
+  default_memory_provider.large_stack[0].push(slab);
+
+  // Destroyed heaps are recycled, and start empty.
+  Heap* heap2 = Heap::create();
+  if (heap2 != heap)
+    abort();
+
+  fill(heap2, objects, r);
+  for (size_t i = 0; i < count; i++)
+    heap2->dealloc(objects[i]);
+  heap2->destroy();
+
+  alloc->dealloc(objects, count * sizeof(void*));
+  current_alloc_pool()->debug_check_empty();
+}
+
+int main(int argc, char** argv)
+{
+  UNUSED(argc);
+  UNUSED(argv);
+
+  test_destroy();
+  return 0;
+}
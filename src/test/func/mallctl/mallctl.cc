@@ -0,0 +1,274 @@
+#include <snmalloc.h>
+
+using namespace snmalloc;
+
+size_t read_size(const char* name)
+{
+  size_t value = 0;
+  size_t len = sizeof(value);
+
+  if (MallCtl::ctl(name, &value, &len, nullptr, 0) != 0)
+    abort();
+
+  return value;
+}
+
+void test_config()
+{
+  if (read_size("config.superslab_size") != SUPERSLAB_SIZE)
+    abort();
+
+  if (read_size("config.sizeclasses") != NUM_SIZECLASSES)
+    abort();
+
+  for (uint8_t i = 0; i < NUM_SIZECLASSES; i++)
+  {
+    char name[64];
+    snprintf(name, sizeof(name), "config.sizeclass.%u.size", i);
+
+    if (read_size(name) != sizeclass_to_size(i))
+      abort();
+  }
+
+  const char* decommit;
+  size_t len = sizeof(decommit);
+  if (MallCtl::ctl("opt.decommit", &decommit, &len, nullptr, 0) != 0)
+    abort();
+
+  // Build-time configuration cannot be written.
+  size_t value = 1;
+  if (MallCtl::ctl("config.slab_size", nullptr, nullptr, &value, 8) != EPERM)
+    abort();
+  if (MallCtl::ctl("opt.decommit", nullptr, nullptr, &decommit, len) != EPERM)
+    abort();
+}
+
+void test_errors()
+{
+  size_t value;
+  size_t len = sizeof(value);
+
+  if (MallCtl::ctl("nonexistent", &value, &len, nullptr, 0) != ENOENT)
+    abort();
+  if (MallCtl::ctl("config.sizeclass", &value, &len, nullptr, 0) != ENOENT)
+    abort();
+  if (MallCtl::ctl("config.slab_size.x", &value, &len, nullptr, 0) != ENOENT)
+    abort();
+  if (MallCtl::ctl("config.sizeclass.9999.size", &value, &len, nullptr, 0) !=
+      ENOENT)
+    abort();
+
+  // Wrong buffer size.
+  uint32_t small;
+  len = sizeof(small);
+  if (MallCtl::ctl("config.slab_size", &small, &len, nullptr, 0) != EINVAL)
+    abort();
+
+  // Invalid value.
+  value = 0;
+  if (
+    MallCtl::ctl("opt.remote_batch", nullptr, nullptr, &value, sizeof(value)) !=
+    EINVAL)
+    abort();
+}
+
+void test_tunables()
+{
+  size_t old = read_size("opt.remote_cache");
+  if (old != REMOTE_CACHE)
+    abort();
+
+  // Write a new value, reading the old one back at the same time.
+  size_t value = 4096;
+  size_t prev;
+  size_t len = sizeof(prev);
+  if (
+    MallCtl::ctl("opt.remote_cache", &prev, &len, &value, sizeof(value)) != 0)
+    abort();
+
+  if ((prev != old) || (read_size("opt.remote_cache") != value))
+    abort();
+
+  // Allocate and free remotely with the new setting.
+  auto* a1 = current_alloc_pool()->acquire();
+  auto* a2 = current_alloc_pool()->acquire();
+
+  for (size_t i = 0; i < 10000; i++)
+    a2->dealloc(a1->alloc(48));
+
+  current_alloc_pool()->release(a1);
+  current_alloc_pool()->release(a2);
+  current_alloc_pool()->debug_check_empty();
+
+  if (
+    MallCtl::ctl("opt.remote_cache", nullptr, nullptr, &old, sizeof(old)) != 0)
+    abort();
+}
+
+void write_size(const char* name, size_t value)
+{
+  if (MallCtl::ctl(name, nullptr, nullptr, &value, sizeof(value)) != 0)
+    abort();
+}
+
+void test_remote_flush()
+{
+  if (
+    (read_size("opt.remote_cache_objects") != REMOTE_CACHE_OBJECTS) ||
+    (read_size("opt.remote_cache_ticks") != REMOTE_CACHE_TICKS))
+    abort();
+
+  // Only flushing or the age of the cache can send these remote frees.
+  write_size("opt.remote_cache_objects", SIZE_MAX);
+  write_size("opt.remote_cache_ticks", 0);
+
+  auto* a1 = current_alloc_pool()->acquire();
+  auto* a2 = current_alloc_pool()->acquire();
+  uint8_t sc = size_to_sizeclass(48);
+  char frees[64];
+  snprintf(frees, sizeof(frees), "stats.sizeclass.%u.frees", sc);
+
+  // The owner counts a free when it receives it.
+  size_t before = read_size(frees);
+  a2->dealloc(a1->alloc(48));
+  a2->flush();
+  a1->flush();
+
+  if (read_size(frees) != before + 1)
+    abort();
+
+  // Once the oldest free is old enough, the next slow path sends the cache.
+  write_size("opt.remote_cache_ticks", 1);
+  before = read_size(frees);
+  a2->dealloc(a1->alloc(48));
+  a2->dealloc(a2->alloc(SUPERSLAB_SIZE * 2));
+  a1->flush();
+
+  if (read_size(frees) != before + 1)
+    abort();
+
+  current_alloc_pool()->release(a1);
+  current_alloc_pool()->release(a2);
+  current_alloc_pool()->debug_check_empty();
+
+  write_size("opt.remote_cache_objects", REMOTE_CACHE_OBJECTS);
+  write_size("opt.remote_cache_ticks", REMOTE_CACHE_TICKS);
+}
+
+void test_counters()
+{
+  auto alloc = ThreadAlloc::get();
+  uint8_t sc = size_to_sizeclass(48);
+  char allocs[64];
+  char frees[64];
+  snprintf(allocs, sizeof(allocs), "stats.sizeclass.%u.allocs", sc);
+  snprintf(frees, sizeof(frees), "stats.sizeclass.%u.frees", sc);
+
+  size_t allocs_before = read_size(allocs);
+  size_t frees_before = read_size(frees);
+  void* p = alloc->alloc(48);
+
+  if (read_size(allocs) != allocs_before + 1)
+    abort();
+
+  alloc->dealloc(p);
+
+  if (read_size(frees) != frees_before + 1)
+    abort();
+
+  if (read_size("stats.committed") > read_size("stats.reserved"))
+    abort();
+
+  size_t allocators = read_size("stats.allocators");
+  size_t total = 0;
+  char name[64];
+
+  for (size_t j = 0; j < allocators; j++)
+  {
+    snprintf(
+      name, sizeof(name), "stats.allocator.%zu.sizeclass.%u.allocs", j, sc);
+    total += read_size(name);
+  }
+
+  if (total != allocs_before + 1)
+    abort();
+}
+
+void test_snapshot()
+{
+  auto alloc = ThreadAlloc::get();
+  uint8_t sc = size_to_sizeclass(48);
+  void* p = alloc->alloc(48);
+  void* large = alloc->alloc(SUPERSLAB_SIZE * 2);
+
+  snmalloc_stats_t s;
+  stats_snapshot(&s);
+
+  if (
+    (s.sizeclasses != NUM_SIZECLASSES) ||
+    (s.large_classes != NUM_LARGE_CLASSES) ||
+    (s.allocators != read_size("stats.allocators")) ||
+    (s.reserved != read_size("stats.reserved")) ||
+    (s.committed != read_size("stats.committed")))
+    abort();
+
+  char name[64];
+  snprintf(name, sizeof(name), "stats.sizeclass.%u.allocs", sc);
+
+  if (
+    (s.sizeclass[sc].size != 48) ||
+    (s.sizeclass[sc].allocs != read_size(name)) ||
+    (s.sizeclass[sc].allocs <= s.sizeclass[sc].frees))
+    abort();
+
+  if (s.allocated < SUPERSLAB_SIZE * 2 + 48)
+    abort();
+
+  alloc->dealloc(large);
+  alloc->dealloc(p);
+}
+
+void test_stats()
+{
+  bool stats;
+  size_t len = sizeof(stats);
+  if (MallCtl::ctl("config.stats", &stats, &len, nullptr, 0) != 0)
+    abort();
+
+  uint8_t sc = size_to_sizeclass(48);
+  char name[64];
+  snprintf(name, sizeof(name), "stats.sizeclass.%u.count", sc);
+
+  if (!stats)
+  {
+    size_t value;
+    len = sizeof(value);
+    if (MallCtl::ctl(name, &value, &len, nullptr, 0) != ENOENT)
+      abort();
+    return;
+  }
+
+  auto alloc = ThreadAlloc::get();
+  size_t before = read_size(name);
+  void* p = alloc->alloc(48);
+
+  if (read_size(name) != before + 1)
+    abort();
+
+  alloc->dealloc(p);
+}
+
+int main(int argc, char** argv)
+{
+  UNUSED(argc);
+  UNUSED(argv);
+
+  test_config();
+  test_errors();
+  test_tunables();
+  test_remote_flush();
+  test_counters();
+  test_snapshot();
+  test_stats();
+  return 0;
+}
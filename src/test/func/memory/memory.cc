@@ -7,7 +7,7 @@ using namespace snmalloc;
 
 void test_alloc_dealloc_64k()
 {
-  auto* alloc = ThreadAlloc::get();
+  auto alloc = ThreadAlloc::get();
 
   constexpr size_t count = 1 << 12;
   constexpr size_t outer_count = 12;
@@ -39,7 +39,7 @@ void test_alloc_dealloc_64k()
 
 void test_random_allocation()
 {
-  auto* alloc = ThreadAlloc::get();
+  auto alloc = ThreadAlloc::get();
   std::unordered_set<void*> allocated;
 
   constexpr size_t count = 10000;
@@ -91,7 +91,7 @@ void test_random_allocation()
 
 void test_calloc()
 {
-  auto* alloc = ThreadAlloc::get();
+  auto alloc = ThreadAlloc::get();
 
   for (size_t size = 16; size <= (1 << 24); size <<= 1)
   {
@@ -162,7 +162,7 @@ void test_double_alloc()
 void test_external_pointer()
 {
   // Malloc does not have an external pointer querying mechanism.
-  auto* alloc = ThreadAlloc::get();
+  auto alloc = ThreadAlloc::get();
 
   for (uint8_t sc = 0; sc < NUM_SIZECLASSES; sc++)
   {
@@ -208,7 +208,7 @@ void test_external_pointer_large()
 {
   xoroshiro::p128r64 r;
 
-  auto* alloc = ThreadAlloc::get();
+  auto alloc = ThreadAlloc::get();
 
   constexpr size_t count_log = snmalloc::bits::is64() ? 5 : 3;
   constexpr size_t count = 1 << count_log;
@@ -244,7 +244,7 @@ void test_external_pointer_large()
 
 void test_alloc_16M()
 {
-  auto* alloc = ThreadAlloc::get();
+  auto alloc = ThreadAlloc::get();
   // sizes >= 16M use large_alloc
   const size_t size = 16'000'000;
 
@@ -253,6 +253,49 @@ void test_alloc_16M()
   alloc->dealloc(p1);
 }
 
+void test_round_size()
+{
+  static_assert(round_size(0) == MIN_ALLOC_SIZE);
+  static_assert(round_size(SLAB_SIZE + 1) > SLAB_SIZE);
+  static_assert(round_size(SUPERSLAB_SIZE - 1) == SUPERSLAB_SIZE);
+  static_assert(round_size(SUPERSLAB_SIZE + 1) == SUPERSLAB_SIZE * 2);
+
+  auto alloc = ThreadAlloc::get();
+
+  for (size_t size = 1; size <= SUPERSLAB_SIZE * 4; size += (size >> 3) + 1)
+  {
+    size_t rsize = round_size(size);
+    void* p = alloc->alloc(size);
+
+    if (Alloc::alloc_size(p) != rsize)
+      abort();
+
+    alloc->dealloc(p);
+
+    // Rounding is idempotent.
+    if (round_size(rsize) != rsize)
+      abort();
+  }
+
+  for (size_t align = 1; align <= SUPERSLAB_SIZE; align <<= 1)
+  {
+    for (size_t size = 1; size <= (1 << 20); size <<= 2)
+    {
+      size_t rsize = aligned_size(align, size);
+
+      if ((rsize < size) || (round_size(rsize) != rsize))
+        abort();
+
+      void* p = alloc->alloc(rsize);
+
+      if (((size_t)p & (align - 1)) != 0)
+        abort();
+
+      alloc->dealloc(p);
+    }
+  }
+}
+
 int main(int argc, char** argv)
 {
 #ifdef USE_SYSTEMATIC_TESTING
@@ -271,6 +314,7 @@ int main(int argc, char** argv)
   test_double_alloc();
   test_external_pointer();
   test_alloc_16M();
+  test_round_size();
 
   return 0;
 }
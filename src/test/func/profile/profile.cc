@@ -0,0 +1,97 @@
+#include <snmalloc.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace snmalloc;
+
+void set_interval(size_t interval)
+{
+  if (
+    MallCtl::ctl(
+      "opt.profile_interval", nullptr, nullptr, &interval, sizeof(interval)) !=
+    0)
+    abort();
+}
+
+NOINLINE void* sampled_call_site(Alloc* alloc, size_t size)
+{
+  return alloc->alloc(size);
+}
+
+void test_profile()
+{
+  constexpr size_t count = 1 << 14;
+  constexpr size_t size = 256;
+  auto alloc = ThreadAlloc::get();
+  void** objects = (void**)alloc->alloc(count * sizeof(void*));
+
+  set_interval(4096);
+
+  // Allocate enough for every allocator to notice that sampling is on.
+  for (size_t i = 0; i < count; i++)
+    objects[i] = sampled_call_site(&*alloc, size);
+
+  for (size_t i = 0; i < count; i++)
+    alloc->dealloc(objects[i]);
+
+  if (heap_profile.samples() != 0)
+    abort();
+
+  for (size_t i = 0; i < count; i++)
+    objects[i] = sampled_call_site(&*alloc, size);
+
+  // Around one sample per 4096 bytes allocated.
+  size_t samples = heap_profile.samples();
+  size_t expected = (count * size) / 4096;
+  if ((samples < expected / 2) || (samples > expected * 2))
+    abort();
+
+  char path[] = "snmalloc_profile_test.heap";
+  const char* p = path;
+  if (MallCtl::ctl("prof.dump", nullptr, nullptr, &p, sizeof(p)) != 0)
+    abort();
+
+  FILE* f = fopen(path, "r");
+  if (f == nullptr)
+    abort();
+
+  char line[256];
+  char header[64];
+  snprintf(header, sizeof(header), "heap profile: %zu: ", samples);
+
+  if (
+    (fgets(line, sizeof(line), f) == nullptr) ||
+    (strncmp(line, header, strlen(header)) != 0) ||
+    (strstr(line, "@ heap_v2/4096") == nullptr))
+    abort();
+
+  size_t lines = 0;
+  while ((fgets(line, sizeof(line), f) != nullptr) &&
+         (strncmp(line, "1: 256 [1: 256] @ 0x", 20) == 0))
+    lines++;
+
+  fclose(f);
+  remove(path);
+
+  if (lines != samples)
+    abort();
+
+  set_interval(0);
+
+  for (size_t i = 0; i < count; i++)
+    alloc->dealloc(objects[i]);
+
+  if (heap_profile.samples() != 0)
+    abort();
+
+  alloc->dealloc(objects, count * sizeof(void*));
+}
+
+int main(int argc, char** argv)
+{
+  UNUSED(argc);
+  UNUSED(argv);
+
+  test_profile();
+  return 0;
+}
@@ -0,0 +1,50 @@
+#include <snmalloc.h>
+
+using namespace snmalloc;
+
+// Runs first, so that nothing in this process has allocated yet, unless the
+// C++ runtime did so before `main`.
+void test_before_first_alloc()
+{
+  bool created = existing_alloc_pool() != nullptr;
+
+  snmalloc_stats_t s;
+  stats_snapshot(&s);
+
+  // Taking a snapshot must not create the pool.
+  if (!created && (existing_alloc_pool() != nullptr))
+    abort();
+
+  if (
+    (s.sizeclasses != NUM_SIZECLASSES) ||
+    (s.large_classes != NUM_LARGE_CLASSES) ||
+    (s.sizeclass[0].size != sizeclass_to_size(0)))
+    abort();
+
+  if (!created && ((s.allocators != 0) || (s.allocated != 0)))
+    abort();
+}
+
+void test_after_alloc()
+{
+  auto alloc = ThreadAlloc::get();
+  void* p = alloc->alloc(48);
+
+  snmalloc_stats_t s;
+  stats_snapshot(&s);
+
+  if ((s.allocators == 0) || (s.allocated < 48))
+    abort();
+
+  alloc->dealloc(p);
+}
+
+int main(int argc, char** argv)
+{
+  UNUSED(argc);
+  UNUSED(argv);
+
+  test_before_first_alloc();
+  test_after_alloc();
+  return 0;
+}
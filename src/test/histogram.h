@@ -1,11 +1,17 @@
 #pragma once
 
 #ifdef USE_MEASURE
+#  include "../ds/fdwriter.h"
 #  include "../ds/flaglock.h"
 
 #  include <algorithm>
+#  include <chrono>
 #  include <iomanip>
 #  include <iostream>
+#  include <limits>
+#  include <signal.h>
+#  include <stdlib.h>
+#  include <thread>
 #  define MEASURE_TIME_MARKERS(id, minbits, maxbits, markers) \
     static constexpr const char* const id##_time_markers[] = markers; \
     static histogram::Global<histogram::Histogram<uint64_t, minbits, maxbits>> \
@@ -30,6 +36,269 @@ namespace histogram
   template<class H>
   class Global;
 
+  enum Format
+  {
+    JSON,
+    CSV
+  };
+
+  // The dumping thread checks for a requested or periodic dump this often.
+  static constexpr std::chrono::milliseconds POLL_PERIOD{100};
+
+  struct Summary
+  {
+    size_t count;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+  };
+
+  /**
+   * The part of `Global` that does not depend on the histogram type, so that
+   * every histogram can be kept on one list for dumping.
+   */
+  class GlobalBase
+  {
+    friend class Registry;
+
+    GlobalBase* next_global = nullptr;
+
+  protected:
+    const char* name;
+    const char* file;
+    size_t line;
+    const char* const* markers;
+
+    GlobalBase(
+      const char* name_,
+      const char* file_,
+      size_t line_,
+      const char* const* markers_)
+    : name(name_), file(file_), line(line_), markers(markers_)
+    {}
+
+  public:
+    /**
+     * Summarise everything recorded so far, including the histograms of
+     * threads that are still running.
+     */
+    virtual Summary summary() = 0;
+  };
+
+  /**
+   * All histograms in the program, and the configuration for dumping them
+   * while it runs.  This is read from the environment:
+   *
+   *  - `SNMALLOC_MEASURE_FILE`: append dumps to this file instead of stderr.
+   *  - `SNMALLOC_MEASURE_FORMAT`: `json` (the default) or `csv`.
+   *  - `SNMALLOC_MEASURE_INTERVAL`: dump every this many seconds.
+   *  - `SNMALLOC_MEASURE_SIGNAL`: dump after receiving this signal.
+   *
+   * Dumps are taken by a thread of their own, which is only started if one of
+   * the last two is set, so that recording stays a counter increment and a
+   * signal handler never touches the histograms.  Values are in the units of
+   * `bits::benchmark_time_start`.
+   */
+  class Registry
+  {
+    std::atomic_flag lock = ATOMIC_FLAG_INIT;
+    GlobalBase* globals = nullptr;
+    size_t dump_id = 0;
+
+    int fd = 2;
+    Format format = JSON;
+    std::chrono::steady_clock::duration interval{0};
+    std::atomic<std::chrono::steady_clock::rep> next_dump{0};
+    std::atomic<bool> requested{false};
+    bool on_request = false;
+
+    static void on_signal(int)
+    {
+      get().requested.store(true, std::memory_order_relaxed);
+    }
+
+    static size_t env(const char* name)
+    {
+      const char* v = getenv(name);
+      return (v == nullptr) ? 0 : strtoul(v, nullptr, 10);
+    }
+
+    Registry()
+    {
+      const char* path = getenv("SNMALLOC_MEASURE_FILE");
+      if (path != nullptr)
+      {
+        int f = FdWriter::open(path, true);
+        if (f >= 0)
+          fd = f;
+      }
+
+      const char* f = getenv("SNMALLOC_MEASURE_FORMAT");
+      if ((f != nullptr) && (strcmp(f, "csv") == 0))
+        format = CSV;
+
+      interval = std::chrono::seconds(env("SNMALLOC_MEASURE_INTERVAL"));
+      next_dump = (std::chrono::steady_clock::now() + interval)
+                    .time_since_epoch()
+                    .count();
+
+      size_t signo = env("SNMALLOC_MEASURE_SIGNAL");
+      if (signo != 0)
+      {
+        signal((int)signo, on_signal);
+        on_request = true;
+      }
+    }
+
+    static void write_markers(FdWriter& out, const char* const* markers)
+    {
+      for (size_t i = 0; (markers != nullptr) && (markers[i] != nullptr); i++)
+      {
+        if (i != 0)
+          out << ' ';
+        out << markers[i];
+      }
+    }
+
+  public:
+    static Registry& get()
+    {
+      static Registry r;
+      return r;
+    }
+
+    void add(GlobalBase* g)
+    {
+      FlagLock f(lock);
+      g->next_global = globals;
+      globals = g;
+    }
+
+    void remove(GlobalBase* g)
+    {
+      FlagLock f(lock);
+
+      for (GlobalBase** prev = &globals; *prev != nullptr;
+           prev = &(*prev)->next_global)
+      {
+        if (*prev == g)
+        {
+          *prev = g->next_global;
+          return;
+        }
+      }
+    }
+
+    /**
+     * Write a summary of every histogram to `out`.  A JSON dump is a single
+     * line, so that periodic dumps to one file can be read line by line.
+     */
+    void dump(int out_fd, Format out_format)
+    {
+      FdWriter out(out_fd);
+      FlagLock f(lock);
+      size_t id = dump_id++;
+
+      if (out_format == JSON)
+        out << "{\"dump\": " << id << ", \"histograms\": [";
+      else if (id == 0)
+        out << "dump, name, markers, file, line, count, p50, p99, p99.9, max\n";
+
+      for (GlobalBase* g = globals; g != nullptr; g = g->next_global)
+      {
+        Summary s = g->summary();
+
+        if (out_format == JSON)
+        {
+          if (g != globals)
+            out << ", ";
+
+          out << "{\"name\": \"" << g->name << "\", \"markers\": \"";
+          write_markers(out, g->markers);
+          out << "\", \"file\": \"" << g->file << "\", \"line\": " << g->line
+              << ", \"count\": " << s.count << ", \"p50\": " << (size_t)s.p50
+              << ", \"p99\": " << (size_t)s.p99
+              << ", \"p99.9\": " << (size_t)s.p999
+              << ", \"max\": " << (size_t)s.max << "}";
+        }
+        else
+        {
+          out << id << ", " << g->name << ", ";
+          write_markers(out, g->markers);
+          out << ", " << g->file << ", " << g->line << ", " << s.count << ", "
+              << (size_t)s.p50 << ", " << (size_t)s.p99 << ", "
+              << (size_t)s.p999 << ", " << (size_t)s.max << '\n';
+        }
+      }
+
+      if (out_format == JSON)
+        out << "]}\n";
+    }
+
+    void dump()
+    {
+      dump(fd, format);
+    }
+
+    /**
+     * Dump if a signal has asked for one or the interval has passed.
+     */
+    void poll()
+    {
+      bool due = requested.exchange(false, std::memory_order_relaxed);
+
+      if (interval.count() != 0)
+      {
+        auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+        auto next = next_dump.load(std::memory_order_relaxed);
+
+        // Only one thread takes each periodic dump.
+        if (
+          (now >= next) &&
+          next_dump.compare_exchange_strong(next, now + interval.count()))
+          due = true;
+      }
+
+      if (due)
+        dump();
+    }
+
+    /**
+     * Start the thread that takes periodic and requested dumps, if either is
+     * configured.
+     */
+    void start()
+    {
+      if ((interval.count() == 0) && !on_request)
+        return;
+
+      std::thread([this]() {
+        while (true)
+        {
+          std::this_thread::sleep_for(POLL_PERIOD);
+          poll();
+        }
+      })
+        .detach();
+    }
+  };
+
+  /**
+   * Starts the dumping thread during static initialisation.  This is not done
+   * when the `Registry` is constructed, which may happen inside an
+   * allocation, because creating a thread allocates.
+   */
+  struct StartDumping
+  {
+    StartDumping()
+    {
+      Registry::get().start();
+    }
+  };
+
+  inline StartDumping start_dumping;
+
   template<
     class V,
     size_t LOW_BITS,
@@ -46,23 +315,32 @@ namespace histogram
     static constexpr V LOW = (V)((size_t)1 << LOW_BITS);
     static constexpr V HIGH = (V)((size_t)1 << HIGH_BITS);
     static constexpr size_t BUCKETS =
-      ((HIGH_BITS - LOW_BITS) << INTERMEDIATE_BITS) + 2;
+      bits::to_exp_mant_const<INTERMEDIATE_BITS, LOW_BITS - INTERMEDIATE_BITS>(
+        HIGH - 1) +
+      1;
 
   private:
     V high = (std::numeric_limits<V>::min)();
-    size_t overflow;
-    size_t count[BUCKETS];
+    size_t overflow = 0;
+    size_t count[BUCKETS] = {};
 
     Global<This>* global;
+    This* next_local = nullptr;
 
   public:
     Histogram() : global(nullptr) {}
-    Histogram(Global<This>& g) : global(&g) {}
+
+    Histogram(Global<This>& g) : global(&g)
+    {
+      global->attach(this);
+    }
+
+    Histogram(const Histogram&) = delete;
 
     ~Histogram()
     {
       if (global != nullptr)
-        global->add(*this);
+        global->detach(this);
     }
 
     void record(V value)
@@ -125,6 +403,37 @@ namespace histogram
         count[i] += that.count[i];
     }
 
+    size_t total()
+    {
+      size_t t = overflow;
+
+      for (size_t i = 0; i < BUCKETS; i++)
+        t += count[i];
+
+      return t;
+    }
+
+    /**
+     * Returns the upper bound of the bucket containing the `num / den`
+     * quantile, or the highest value if that is in the overflow bucket.
+     */
+    V quantile(size_t num, size_t den)
+    {
+      size_t t = total();
+      size_t rank = ((t * num) + den - 1) / den;
+      size_t cumulative = 0;
+
+      for (size_t i = 0; i < BUCKETS; i++)
+      {
+        cumulative += count[i];
+
+        if ((cumulative >= rank) && (cumulative != 0))
+          return (std::min)(get_range(i).second, high);
+      }
+
+      return high;
+    }
+
     void print(std::ostream& o)
     {
       o << "\tHigh: " << high << std::endl
@@ -172,35 +481,73 @@ namespace histogram
   };
 
   template<class H>
-  class Global
+  class Global : public GlobalBase
   {
   private:
-    const char* name;
-    const char* file;
-    size_t line;
-    const char* const* markers;
-
     std::atomic_flag lock = ATOMIC_FLAG_INIT;
     H aggregate;
 
+    // Histograms of threads that are still running.
+    H* locals = nullptr;
+
   public:
     Global(
       const char* name_,
       const char* file_,
       size_t line_,
-      const char* const* markers)
-    : name(name_), file(file_), line(line_), markers(markers)
-    {}
+      const char* const* markers_)
+    : GlobalBase(name_, file_, line_, markers_)
+    {
+      Registry::get().add(this);
+    }
 
     ~Global()
     {
+      Registry::get().remove(this);
       print();
     }
 
-    void add(H& histogram)
+    void attach(H* histogram)
+    {
+      FlagLock f(lock);
+      histogram->next_local = locals;
+      locals = histogram;
+    }
+
+    /**
+     * Fold in the histogram of a thread that is exiting.
+     */
+    void detach(H* histogram)
+    {
+      FlagLock f(lock);
+      aggregate.add(*histogram);
+
+      for (H** prev = &locals; *prev != nullptr; prev = &(*prev)->next_local)
+      {
+        if (*prev == histogram)
+        {
+          *prev = histogram->next_local;
+          break;
+        }
+      }
+    }
+
+    Summary summary() override
     {
+      // The running threads' histograms are read while they are being
+      // updated, so the merge is approximate.
+      H merged;
       FlagLock f(lock);
-      aggregate.add(histogram);
+      merged.add(aggregate);
+
+      for (H* h = locals; h != nullptr; h = h->next_local)
+        merged.add(*h);
+
+      return {merged.total(),
+              merged.quantile(1, 2),
+              merged.quantile(99, 100),
+              merged.quantile(999, 1000),
+              merged.get_high()};
     }
 
   private:
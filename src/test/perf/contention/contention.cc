@@ -1,5 +1,4 @@
-#include "test/measuretime.h"
-#include "test/opt.h"
+#include "test/benchmark.h"
 #include "test/usage.h"
 #include "test/xoroshiro.h"
 
@@ -19,8 +18,8 @@ class ParallelTest
 private:
   std::atomic<bool> flag = false;
   std::atomic<size_t> ready = 0;
-  uint64_t start;
-  uint64_t end;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point end;
   std::atomic<size_t> complete = 0;
 
   size_t cores;
@@ -30,7 +29,7 @@ private:
     auto prev = ready.fetch_add(1);
     if (prev + 1 == cores)
     {
-      start = bits::tick();
+      start = std::chrono::steady_clock::now();
       flag = true;
     }
     while (!flag)
@@ -41,7 +40,7 @@ private:
     prev = complete.fetch_add(1);
     if (prev + 1 == cores)
     {
-      end = bits::tick();
+      end = std::chrono::steady_clock::now();
     }
   }
 
@@ -63,9 +62,9 @@ public:
     delete[] t;
   }
 
-  uint64_t time()
+  std::chrono::nanoseconds time()
   {
-    return end - start;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
   }
 };
 
@@ -75,7 +74,7 @@ size_t swapcount;
 
 void test_tasks_f(size_t id)
 {
-  Alloc* a = ThreadAlloc::get();
+  auto a = ThreadAlloc::get();
   xoroshiro::p128r32 r(id + 5000);
 
   for (size_t n = 0; n < swapcount; n++)
@@ -98,14 +97,14 @@ void test_tasks_f(size_t id)
   }
 };
 
-void test_tasks(size_t num_tasks, size_t count, size_t size)
+std::chrono::nanoseconds run_tasks(size_t num_tasks)
 {
-  Alloc* a = ThreadAlloc::get();
+  auto a = ThreadAlloc::get();
 
-  contention = new std::atomic<size_t*>[size];
+  contention = new std::atomic<size_t*>[swapsize];
   xoroshiro::p128r32 r;
 
-  for (size_t n = 0; n < size; n++)
+  for (size_t n = 0; n < swapsize; n++)
   {
     size_t alloc_size = 16 + (r.next() % 1024);
     size_t* res =
@@ -113,34 +112,35 @@ void test_tasks(size_t num_tasks, size_t count, size_t size)
     *res = alloc_size;
     contention[n] = res;
   }
-  swapcount = count;
-  swapsize = size;
 
-#ifdef USE_SNMALLOC_STATS
-  Stats s0;
-  current_alloc_pool()->aggregate_stats(s0);
-#endif
+  ParallelTest<test_tasks_f> test(num_tasks);
 
+  for (size_t n = 0; n < swapsize; n++)
   {
-    ParallelTest<test_tasks_f> test(num_tasks);
-
-    std::cout << "Task test, " << num_tasks << " threads, " << count
-              << " swaps per thread " << test.time() << "ticks" << std::endl;
-
-    for (size_t n = 0; n < swapsize; n++)
+    if (contention[n] != nullptr)
     {
-      if (contention[n] != nullptr)
-      {
-        if (use_malloc)
-          free(contention[n]);
-        else
-          a->dealloc(contention[n], *contention[n]);
-      }
+      if (use_malloc)
+        free(contention[n]);
+      else
+        a->dealloc(contention[n], *contention[n]);
     }
-
-    delete[] contention;
   }
 
+  delete[] contention;
+  return test.time();
+}
+
+void test_tasks(
+  benchmark::Harness& harness, size_t num_tasks, size_t count, size_t size)
+{
+  swapcount = count;
+  swapsize = size;
+
+  harness.run(
+    "Task test, " + std::to_string(num_tasks) + " threads, " +
+      std::to_string(count) + " swaps per thread",
+    [&]() { return run_tasks(num_tasks); });
+
 #ifndef NDEBUG
   current_alloc_pool()->debug_check_empty();
 #endif
@@ -154,12 +154,13 @@ int main(int argc, char** argv)
   size_t count = opt.is<size_t>("--swapcount", 1 << 20);
   size_t size = opt.is<size_t>("--swapsize", 1 << 18);
   use_malloc = opt.has("--use_malloc");
+  benchmark::Harness harness(opt, 3);
 
   std::cout << "Allocator is " << (use_malloc ? "System" : "snmalloc")
             << std::endl;
 
   for (size_t i = cores; i > 0; i >>= 1)
-    test_tasks(i, count, size);
+    test_tasks(harness, i, count, size);
 
   if (opt.has("--stats"))
   {
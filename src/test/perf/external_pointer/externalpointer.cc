@@ -1,7 +1,6 @@
 #include <snmalloc.h>
-#include <test/measuretime.h>
+#include <test/benchmark.h>
 #include <test/xoroshiro.h>
-#include <unordered_set>
 
 using namespace snmalloc;
 
@@ -39,13 +38,14 @@ NOINLINE void teardown(Alloc* alloc)
   current_alloc_pool()->debug_check_empty();
 }
 
-void test_external_pointer(xoroshiro::p128r64& r)
+void test_external_pointer(
+  benchmark::Harness& harness, xoroshiro::p128r64& r)
 {
-  auto* alloc = ThreadAlloc::get();
+  auto alloc = ThreadAlloc::get();
 
-  setup(r, alloc);
+  setup(r, &*alloc);
 
-  DO_TIME("External pointer queries ", {
+  harness.run("External pointer queries", [&]() {
     for (size_t i = 0; i < 10000000; i++)
     {
       size_t rand = (size_t)r.next();
@@ -60,19 +60,19 @@ void test_external_pointer(xoroshiro::p128r64& r)
     }
   });
 
-  teardown(alloc);
+  teardown(&*alloc);
 }
 
-int main(int, char**)
+int main(int argc, char** argv)
 {
+  opt::Opt opt(argc, argv);
   xoroshiro::p128r64 r;
 #if NDEBUG
-  size_t nn = 30;
+  benchmark::Harness harness(opt, 30);
 #else
-  size_t nn = 3;
+  benchmark::Harness harness(opt, 3);
 #endif
 
-  for (size_t n = 0; n < nn; n++)
-    test_external_pointer(r);
+  test_external_pointer(harness, r);
   return 0;
 }
@@ -0,0 +1,206 @@
+#include "test/opt.h"
+#include "test/usage.h"
+#include "test/xoroshiro.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <snmalloc.h>
+#include <thread>
+#include <vector>
+
+using namespace snmalloc;
+
+// Measures how much memory the process keeps resident through phases that
+// commonly leave memory stranded in an allocator: a ramp up followed by
+// freeing most of it, shifting the live data from one sizeclass to another,
+// and threads that exit while other threads still hold their objects.  Each
+// phase reports the resident and proportional set sizes, the peak resident
+// size, and the allocator's own count of committed and allocated memory.
+
+#if defined(__linux__)
+
+size_t total;
+
+void report(const char* phase, usage::RssSampler& sampler)
+{
+  snmalloc_stats_t* s = new snmalloc_stats_t;
+  stats_snapshot(s);
+
+  std::cout << std::setw(20) << phase << ": rss " << std::setw(6)
+            << (usage::rss() >> 20) << " MiB, pss " << std::setw(6)
+            << (usage::pss() >> 20) << " MiB, peak " << std::setw(6)
+            << (sampler.peak() >> 20) << " MiB, committed " << std::setw(6)
+            << (s->committed >> 20) << " MiB, allocated " << std::setw(6)
+            << (s->allocated >> 20) << " MiB" << std::endl;
+
+  delete s;
+  sampler.reset();
+}
+
+/**
+ * Allocate `total` bytes of random sizes, then free a random 90% of it, then
+ * the rest.
+ */
+void test_ramp(usage::RssSampler& sampler)
+{
+  auto a = ThreadAlloc::get();
+  xoroshiro::p128r64 r;
+  std::vector<void*> objects;
+  size_t allocated = 0;
+
+  while (allocated < total)
+  {
+    size_t size = 16 + (r.next() % 1024);
+    void* p = a->alloc(size);
+    memset(p, 1, size);
+    objects.push_back(p);
+    allocated += size;
+  }
+
+  report("ramp", sampler);
+
+  for (size_t i = objects.size() - 1; i > 0; i--)
+    std::swap(objects[i], objects[r.next() % (i + 1)]);
+
+  size_t keep = objects.size() / 10;
+
+  for (size_t i = keep; i < objects.size(); i++)
+    a->dealloc(objects[i]);
+
+  report("free 90%", sampler);
+
+  for (size_t i = 0; i < keep; i++)
+    a->dealloc(objects[i]);
+
+  report("free all", sampler);
+}
+
+/**
+ * Fill `total` bytes with objects of one size, free them, and move on to
+ * the next size, so that memory must be reused across sizeclasses.
+ */
+void test_shift(usage::RssSampler& sampler)
+{
+  auto a = ThreadAlloc::get();
+  const size_t sizes[] = {32, 256, 2048, 16384, 128};
+
+  for (size_t size : sizes)
+  {
+    {
+      std::vector<void*> objects(total / size);
+
+      for (auto& p : objects)
+      {
+        p = a->alloc(size);
+        memset(p, 1, size);
+      }
+
+      for (auto& p : objects)
+        a->dealloc(p, size);
+    }
+
+    char phase[32];
+    snprintf(phase, sizeof(phase), "shift to %zu", size);
+    report(phase, sampler);
+  }
+}
+
+std::mutex kept_lock;
+std::vector<void*> kept;
+
+void churn_thread(size_t id, size_t bytes)
+{
+  auto a = ThreadAlloc::get();
+  xoroshiro::p128r64 r(id + 1);
+  std::vector<void*> objects;
+  size_t allocated = 0;
+
+  while (allocated < bytes)
+  {
+    size_t size = 16 + (r.next() % 1024);
+    void* p = a->alloc(size);
+    memset(p, 1, size);
+    objects.push_back(p);
+    allocated += size;
+  }
+
+  // Free most objects locally, and leave the rest for the main thread.
+  std::lock_guard<std::mutex> guard(kept_lock);
+
+  for (size_t i = 0; i < objects.size(); i++)
+  {
+    if ((i % 10) == 0)
+      kept.push_back(objects[i]);
+    else
+      a->dealloc(objects[i]);
+  }
+}
+
+/**
+ * Run waves of short-lived threads, each of which leaves a tenth of its
+ * objects to be freed by the main thread.
+ */
+void test_churn(usage::RssSampler& sampler, size_t threads, size_t waves)
+{
+  for (size_t w = 0; w < waves; w++)
+  {
+    std::vector<std::thread> running;
+
+    for (size_t t = 0; t < threads; t++)
+      running.emplace_back(churn_thread, (w * threads) + t, total / threads);
+
+    for (auto& t : running)
+      t.join();
+  }
+
+  report("churn", sampler);
+
+  auto a = ThreadAlloc::get();
+
+  for (void* p : kept)
+    a->dealloc(p);
+
+  kept.clear();
+  kept.shrink_to_fit();
+
+  report("churn freed", sampler);
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+#if NDEBUG
+  total = opt.is<size_t>("--mib", 256) << 20;
+#else
+  total = opt.is<size_t>("--mib", 16) << 20;
+#endif
+  size_t threads = opt.is<size_t>("--threads", 8);
+  size_t waves = opt.is<size_t>("--waves", 4);
+
+  {
+    usage::RssSampler sampler;
+    report("start", sampler);
+
+    test_ramp(sampler);
+    test_shift(sampler);
+    test_churn(sampler, threads, waves);
+  }
+
+#  ifndef NDEBUG
+  current_alloc_pool()->debug_check_empty();
+#  endif
+
+  return 0;
+}
+
+#else
+
+int main(int, char**)
+{
+  std::cout << "Resident memory is only measured on Linux" << std::endl;
+  return 0;
+}
+
+#endif
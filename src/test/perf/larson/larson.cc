@@ -0,0 +1,144 @@
+#include "test/benchmark.h"
+#include "test/xoroshiro.h"
+
+#include <iostream>
+#include <snmalloc.h>
+#include <thread>
+#include <vector>
+
+using namespace snmalloc;
+
+// A port of the Larson server benchmark.  Each thread owns an array of
+// objects and repeatedly replaces a random one with a new object of random
+// size.  After a fixed number of replacements the thread exits and a new
+// thread takes over its array, so most objects are freed by a different
+// thread from the one that allocated them, and allocators are constantly
+// released and reused as threads come and go.
+
+bool use_malloc = false;
+
+size_t min_size;
+size_t max_size;
+size_t slots;
+size_t ops;
+
+struct Worker
+{
+  void** objects;
+  size_t seed;
+};
+
+void* test_alloc(size_t size)
+{
+  if (use_malloc)
+    return malloc(size);
+
+  return ThreadAlloc::get()->alloc(size);
+}
+
+void test_free(void* p)
+{
+  if (use_malloc)
+    free(p);
+  else
+    ThreadAlloc::get()->dealloc(p, *(size_t*)p);
+}
+
+void* new_object(xoroshiro::p128r32& r)
+{
+  size_t size = min_size + (r.next() % (max_size - min_size + 1));
+  size_t* p = (size_t*)test_alloc(size);
+  *p = size;
+  return p;
+}
+
+void run(Worker* w)
+{
+  xoroshiro::p128r32 r(w->seed);
+
+  for (size_t n = 0; n < ops; n++)
+  {
+    size_t i = r.next() % slots;
+    test_free(w->objects[i]);
+    w->objects[i] = new_object(r);
+  }
+
+  // The next thread to take over this array continues the sequence.
+  w->seed = r.next();
+}
+
+void test_larson(benchmark::Harness& harness, size_t threads, size_t rounds)
+{
+  std::vector<Worker> workers(threads);
+  xoroshiro::p128r32 r(threads);
+
+  for (size_t t = 0; t < threads; t++)
+  {
+    workers[t].objects = new void*[slots];
+    workers[t].seed = t + 1;
+
+    for (size_t i = 0; i < slots; i++)
+      workers[t].objects[i] = new_object(r);
+  }
+
+  harness.run(
+    "Larson, " + std::to_string(threads) + " threads, " +
+      std::to_string(rounds) + " rounds of " + std::to_string(ops) + " ops",
+    [&]() {
+      for (size_t round = 0; round < rounds; round++)
+      {
+        std::vector<std::thread> running;
+
+        for (size_t t = 0; t < threads; t++)
+          running.emplace_back(run, &workers[t]);
+
+        for (auto& t : running)
+          t.join();
+      }
+    });
+
+  for (auto& w : workers)
+  {
+    for (size_t i = 0; i < slots; i++)
+      test_free(w.objects[i]);
+
+    delete[] w.objects;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  size_t cores = opt.is<size_t>("--cores", 8);
+  size_t rounds = opt.is<size_t>("--rounds", 10);
+  min_size = opt.is<size_t>("--min", 16);
+  max_size = opt.is<size_t>("--max", 1024);
+  slots = opt.is<size_t>("--slots", 1000);
+#if NDEBUG
+  ops = opt.is<size_t>("--ops", 1 << 16);
+#else
+  ops = opt.is<size_t>("--ops", 1 << 12);
+#endif
+  use_malloc = opt.has("--use_malloc");
+  benchmark::Harness harness(opt, 5);
+
+  if ((min_size < sizeof(size_t)) || (max_size < min_size))
+  {
+    std::cout << "Sizes must be at least " << sizeof(size_t) << " bytes"
+              << std::endl;
+    return 1;
+  }
+
+  std::cout << "Allocator is " << (use_malloc ? "System" : "snmalloc")
+            << std::endl;
+
+  for (size_t i = cores; i > 0; i >>= 1)
+    test_larson(harness, i, rounds);
+
+#ifndef NDEBUG
+  if (!use_malloc)
+    current_alloc_pool()->debug_check_empty();
+#endif
+
+  return 0;
+}
@@ -0,0 +1,139 @@
+#include "test/benchmark.h"
+#include "test/xoroshiro.h"
+
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <snmalloc.h>
+
+using namespace snmalloc;
+
+#if defined(__linux__) && !defined(OPEN_ENCLAVE)
+#  include <pthread.h>
+#  include <sched.h>
+#  include <unistd.h>
+
+// Compare per-thread allocators with per-CPU allocators when there are many
+// more threads than cores.  Threads are created with pthreads directly, as
+// std::thread allocates its state with operator new, which would give every
+// thread a per-thread allocator in both configurations.
+
+size_t rounds;
+size_t batch;
+
+// The distinct allocators that any thread has used, filled from the front.
+// A thread can move between allocators as it migrates between CPUs, so this
+// is updated on every lookup rather than once per thread.
+std::atomic<Alloc*>* used;
+size_t used_capacity;
+
+void record(Alloc* a, Alloc*& last)
+{
+  if (a == last)
+    return;
+
+  last = a;
+  for (size_t i = 0; i < used_capacity; i++)
+  {
+    Alloc* expected = used[i].load(std::memory_order_relaxed);
+    if (expected == nullptr && used[i].compare_exchange_strong(expected, a))
+      return;
+    if (expected == a)
+      return;
+  }
+}
+
+template<class TA>
+void* worker(void* arg)
+{
+  size_t id = (size_t)arg;
+  xoroshiro::p128r32 r(id + 1);
+  Alloc* last = nullptr;
+  void** objects;
+  {
+    auto a = TA::get();
+    record(&*a, last);
+    objects = (void**)a->alloc(batch * sizeof(void*));
+  }
+
+  for (size_t n = 0; n < rounds; n++)
+  {
+    for (size_t i = 0; i < batch; i++)
+    {
+      size_t size = 16 + (r.next() % 1024);
+      auto a = TA::get();
+      record(&*a, last);
+      objects[i] = a->alloc(size);
+      *(size_t*)objects[i] = size;
+    }
+
+    for (size_t i = 0; i < batch; i++)
+    {
+      auto a = TA::get();
+      record(&*a, last);
+      a->dealloc(objects[i], *(size_t*)objects[i]);
+    }
+
+    // Most threads in the services we care about spend their time idle.
+    sched_yield();
+  }
+
+  TA::get()->dealloc(objects, batch * sizeof(void*));
+  return nullptr;
+}
+
+template<class TA>
+void test_threads(
+  benchmark::Harness& harness, const char* name, size_t threads)
+{
+  pthread_t* t = (pthread_t*)malloc(threads * sizeof(pthread_t));
+
+  // Enough for one allocator per thread plus one per CPU slot.
+  used_capacity = threads + (size_t)sysconf(_SC_NPROCESSORS_CONF);
+  used = (std::atomic<Alloc*>*)calloc(used_capacity, sizeof(Alloc*));
+
+  harness.run(
+    std::string(name) + ", " + std::to_string(threads) + " threads", [&]() {
+      for (size_t i = 0; i < threads; i++)
+        pthread_create(&t[i], nullptr, worker<TA>, (void*)i);
+
+      for (size_t i = 0; i < threads; i++)
+        pthread_join(t[i], nullptr);
+    });
+
+  size_t distinct = 0;
+  while ((distinct < used_capacity) && (used[distinct] != nullptr))
+    distinct++;
+
+  std::cout << name << ": " << distinct << " allocators used, "
+            << current_alloc_pool()->allocator_count() << " in pool"
+            << std::endl;
+
+  free(used);
+  free(t);
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  size_t cores = (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+  size_t threads = opt.is<size_t>("--threads", cores * 10);
+  rounds = opt.is<size_t>("--rounds", 100);
+  batch = opt.is<size_t>("--batch", 64);
+
+  std::cout << cores << " cores, " << threads << " threads" << std::endl;
+
+  benchmark::Harness harness(opt, 5);
+
+  test_threads<ThreadAllocExplicitTLSCleanup>(harness, "Per-thread", threads);
+  test_threads<ThreadAllocPerCPU>(harness, "Per-CPU", threads);
+
+  return 0;
+}
+#else
+int main(int, char**)
+{
+  std::cout << "Per-CPU allocators are only supported on Linux" << std::endl;
+  return 0;
+}
+#endif
@@ -0,0 +1,246 @@
+#include "test/opt.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <snmalloc.h>
+#include <thread>
+#include <vector>
+
+using namespace snmalloc;
+
+// Producer threads allocate objects and hand them to consumer threads over
+// single-producer single-consumer rings, and the consumers free them.  Every
+// free is remote, so this measures the path from `RemoteCache` through the
+// owner's message queue and back into its free lists.
+//
+// To see how long that takes, a consumer stamps each object just before
+// freeing it.  When the producer is given the same memory back by its
+// allocator it reads the stamp, so the latency is the time from the remote
+// free to the object being reused by its owner, which includes the time it
+// spends on the owner's free list.  The stamp is kept past the words that the
+// allocator uses for its free lists and remote messages.
+
+static constexpr size_t RING_SIZE = 1024;
+static constexpr size_t STAMP_WORD = 3;
+static constexpr size_t MIN_SIZE = (STAMP_WORD + 2) * sizeof(uint64_t);
+static constexpr uint64_t STAMP_MAGIC = 0x5ca1ab1e5ca1ab1e;
+
+struct alignas(64) Ring
+{
+  std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+  alignas(64) void* slots[RING_SIZE];
+
+  bool push(void* p)
+  {
+    size_t t = tail.load(std::memory_order_relaxed);
+
+    if (t - head.load(std::memory_order_acquire) == RING_SIZE)
+      return false;
+
+    slots[t % RING_SIZE] = p;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  void* pop()
+  {
+    size_t h = head.load(std::memory_order_relaxed);
+
+    if (h == tail.load(std::memory_order_acquire))
+      return nullptr;
+
+    void* p = slots[h % RING_SIZE];
+    head.store(h + 1, std::memory_order_release);
+    return p;
+  }
+};
+
+size_t producers;
+size_t consumers;
+size_t count;
+size_t object_size;
+
+// One ring for each (producer, consumer) pair.
+Ring* rings;
+std::atomic<size_t> producers_done;
+std::vector<uint64_t>* latencies;
+
+Ring& ring(size_t producer, size_t consumer)
+{
+  return rings[(producer * consumers) + consumer];
+}
+
+void producer(size_t id)
+{
+  auto a = ThreadAlloc::get();
+  auto& samples = latencies[id];
+
+  for (size_t n = 0; n < count; n++)
+  {
+    uint64_t* p = (uint64_t*)a->alloc(object_size);
+
+    if (p[STAMP_WORD] == STAMP_MAGIC)
+    {
+      if (samples.size() < samples.capacity())
+        samples.push_back(bits::tick() - p[STAMP_WORD + 1]);
+    }
+
+    p[STAMP_WORD] = 0;
+
+    Ring& r = ring(id, n % consumers);
+    while (!r.push(p))
+      bits::pause();
+  }
+
+  producers_done++;
+}
+
+void consumer(size_t id)
+{
+  auto a = ThreadAlloc::get();
+
+  while (true)
+  {
+    // Read the flag first, so that nothing pushed before the last producer
+    // finished can be missed.
+    bool done = producers_done.load() == producers;
+    bool found = false;
+
+    for (size_t i = 0; i < producers; i++)
+    {
+      while (uint64_t* p = (uint64_t*)ring(i, id).pop())
+      {
+        p[STAMP_WORD] = STAMP_MAGIC;
+        p[STAMP_WORD + 1] = bits::tick();
+        a->dealloc(p, object_size);
+        found = true;
+      }
+    }
+
+    if (done && !found)
+      return;
+
+    if (!found)
+      bits::pause();
+  }
+}
+
+uint64_t percentile(std::vector<uint64_t>& v, size_t p)
+{
+  if (v.empty())
+    return 0;
+
+  return v[((v.size() - 1) * p) / 1000];
+}
+
+void test_producer_consumer(size_t p, size_t c, size_t size, size_t n)
+{
+  producers = p;
+  consumers = c;
+  object_size = size;
+  count = n;
+  producers_done = 0;
+  rings = new Ring[p * c];
+  latencies = new std::vector<uint64_t>[p];
+
+  for (size_t i = 0; i < p; i++)
+    latencies[i].reserve(1 << 16);
+
+  snmalloc_stats_t* received = new snmalloc_stats_t;
+  snmalloc_stats_t* sent = new snmalloc_stats_t;
+  size_t backlog_max = 0;
+  size_t backlog_total = 0;
+  size_t backlog_samples = 0;
+
+  auto start = std::chrono::steady_clock::now();
+
+  {
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < c; i++)
+      threads.emplace_back(consumer, i);
+
+    for (size_t i = 0; i < p; i++)
+      threads.emplace_back(producer, i);
+
+    // Sample the number of remote frees that have not yet reached their
+    // owner while the producers run.  Snapshots are not atomic, so read the
+    // receives before the frees to avoid counting a message as received
+    // before it was sent.
+    while (producers_done.load() != producers)
+    {
+      stats_snapshot(received);
+      stats_snapshot(sent);
+      size_t backlog = sent->remote_frees - received->remote_receives;
+      backlog_max = (std::max)(backlog_max, backlog);
+      backlog_total += backlog;
+      backlog_samples++;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    for (auto& t : threads)
+      t.join();
+  }
+
+  auto finish = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(finish - start).count();
+
+  {
+    std::vector<uint64_t> all;
+    for (size_t i = 0; i < p; i++)
+      all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+    std::sort(all.begin(), all.end());
+
+    std::cout << std::setw(3) << p << " producers " << std::setw(3) << c
+              << " consumers " << std::setw(6) << size << " bytes: "
+              << std::setw(8) << (size_t)(((double)(p * n) / seconds) / 1000)
+              << " kobj/s, backlog mean "
+              << (backlog_samples == 0 ? 0 : backlog_total / backlog_samples)
+              << " max " << backlog_max << ", reuse latency (ticks) p50 "
+              << percentile(all, 500) << " p99 " << percentile(all, 990)
+              << " max " << (all.empty() ? 0 : all.back()) << " ("
+              << all.size() << " samples)" << std::endl;
+  }
+
+  delete sent;
+  delete received;
+  delete[] latencies;
+  delete[] rings;
+
+#ifndef NDEBUG
+  current_alloc_pool()->debug_check_empty();
+#endif
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  size_t max_producers = opt.is<size_t>("--producers", 4);
+  size_t max_consumers = opt.is<size_t>("--consumers", 4);
+#if NDEBUG
+  size_t n = opt.is<size_t>("--count", 1 << 16);
+#else
+  size_t n = opt.is<size_t>("--count", 1 << 13);
+#endif
+  size_t only_size = opt.is<size_t>("--size", 0);
+
+  const size_t sizes[] = {64, 512, 4096};
+  static_assert(MIN_SIZE <= 64, "The stamp does not fit the smallest size");
+
+  for (size_t size : sizes)
+  {
+    if ((only_size != 0) && (size != only_size))
+      continue;
+
+    for (size_t p = 1; p <= max_producers; p <<= 1)
+    {
+      for (size_t c = 1; c <= max_consumers; c <<= 1)
+        test_producer_consumer(p, c, size, n);
+    }
+  }
+
+  return 0;
+}
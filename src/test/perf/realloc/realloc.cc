@@ -0,0 +1,214 @@
+#include "test/benchmark.h"
+
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define SNMALLOC_NAME_MANGLE(a) snmalloc_##a
+#include "../../../override/malloc.cc"
+
+// Grows buffers the way `std::vector` and string builders do, by repeated
+// `realloc` to 1.5 or 2 times the previous size, and measures the time
+// spent in the `realloc` calls, summed over all threads.  A `realloc` that
+// returns the same pointer avoided a copy; one that moves the buffer must
+// copy its contents.  snmalloc never resizes in place, so only the system
+// allocator can avoid copies.  The newly grown
+// part of each buffer is written between calls, outside the timing, as a
+// program filling the buffer would.
+//
+// Many small buffers grow at once on several threads, and then a single
+// buffer grows to `--max`.  `--use_malloc` uses the system allocator as a
+// baseline.
+
+bool use_malloc = false;
+
+void* test_realloc(void* p, size_t size)
+{
+  if (use_malloc)
+    return realloc(p, size);
+
+  return snmalloc_realloc(p, size);
+}
+
+void test_free(void* p)
+{
+  if (use_malloc)
+    free(p);
+  else
+    snmalloc_free(p);
+}
+
+struct Result
+{
+  size_t reallocs = 0;
+  size_t in_place = 0;
+  size_t bytes_moved = 0;
+  std::chrono::nanoseconds time{0};
+
+  void add(const Result& that)
+  {
+    reallocs += that.reallocs;
+    in_place += that.in_place;
+    bytes_moved += that.bytes_moved;
+    time += that.time;
+  }
+};
+
+struct Buffer
+{
+  char* p = nullptr;
+  size_t size = 0;
+};
+
+size_t next_size(size_t size, size_t growth)
+{
+  // `growth` is in halves, so 3 is 1.5x and 4 is 2x.
+  return (size * growth) / 2;
+}
+
+/**
+ * Grow `b` to its next size, recording the cost in `r`.
+ */
+void grow(Buffer& b, size_t growth, size_t max, Result& r)
+{
+  size_t size = b.size == 0 ? 16 : next_size(b.size, growth);
+  size = size < max ? size : max;
+
+  auto start = std::chrono::steady_clock::now();
+  char* p = (char*)test_realloc(b.p, size);
+  r.time += std::chrono::steady_clock::now() - start;
+
+  if (p == nullptr)
+    abort();
+
+  if (b.p != nullptr)
+  {
+    if ((p[0] != 1) || (p[b.size - 1] != 1))
+      abort();
+
+    if (p == b.p)
+      r.in_place++;
+    else
+      r.bytes_moved += b.size;
+  }
+
+  r.reallocs++;
+  memset(p + b.size, 1, size - b.size);
+  b.p = p;
+  b.size = size;
+}
+
+void grow_many(size_t buffers, size_t growth, size_t max, Result* out)
+{
+  std::vector<Buffer> b(buffers);
+  Result r;
+  bool growing = true;
+
+  // Grow the buffers in turn, so that they compete for the space after
+  // each other.
+  while (growing)
+  {
+    growing = false;
+
+    for (auto& buffer : b)
+    {
+      if (buffer.size < max)
+      {
+        grow(buffer, growth, max, r);
+        growing = true;
+      }
+    }
+  }
+
+  for (auto& buffer : b)
+    test_free(buffer.p);
+
+  *out = r;
+}
+
+std::string growth_name(size_t growth)
+{
+  return growth == 3 ? "1.5x" : "2.0x";
+}
+
+/**
+ * Report the counts from one run, and the median time of the runs in
+ * `timing` divided among its reallocs.
+ */
+void report(const std::string& name, Result& r, benchmark::Result& timing)
+{
+  std::cout << name << ": " << r.reallocs << " reallocs, " << r.in_place
+            << " in place, " << (r.bytes_moved >> 10) << " KiB moved, "
+            << (r.reallocs == 0 ? 0 : (size_t)timing.median / r.reallocs)
+            << " ns per realloc" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  size_t threads = opt.is<size_t>("--threads", 4);
+  size_t buffers = opt.is<size_t>("--buffers", 32);
+  size_t small_max = opt.is<size_t>("--small_max", 1 << 20);
+#if NDEBUG
+  size_t max = opt.is<size_t>("--max", (size_t)1 << 30);
+#else
+  size_t max = opt.is<size_t>("--max", (size_t)16 << 20);
+#endif
+  use_malloc = opt.has("--use_malloc");
+  benchmark::Harness harness(opt, 5);
+
+  std::cout << "Allocator is " << (use_malloc ? "System" : "snmalloc")
+            << std::endl;
+
+  for (size_t growth = 3; growth <= 4; growth++)
+  {
+    std::string name = std::to_string(threads * buffers) + " buffers to " +
+      std::to_string(small_max >> 10) + " KiB, " + growth_name(growth);
+    Result total;
+
+    auto timing = harness.run(name, [&]() {
+      std::vector<Result> results(threads);
+      std::vector<std::thread> running;
+
+      for (size_t t = 0; t < threads; t++)
+        running.emplace_back(
+          grow_many, buffers, growth, small_max, &results[t]);
+
+      for (auto& t : running)
+        t.join();
+
+      total = Result();
+      for (auto& r : results)
+        total.add(r);
+
+      return total.time;
+    });
+
+    report(name, total, timing);
+  }
+
+  for (size_t growth = 3; growth <= 4; growth++)
+  {
+    std::string name = "1 buffer to " + std::to_string(max >> 20) + " MiB, " +
+      growth_name(growth);
+    Result r;
+
+    auto timing = harness.run(name, [&]() {
+      r = Result();
+      grow_many(1, growth, max, &r);
+      return r.time;
+    });
+
+    report(name, r, timing);
+  }
+
+#ifndef NDEBUG
+  if (!use_malloc)
+    current_alloc_pool()->debug_check_empty();
+#endif
+
+  return 0;
+}
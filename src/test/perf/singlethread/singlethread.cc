@@ -1,82 +1,94 @@
+#include <algorithm>
 #include <snmalloc.h>
-#include <test/measuretime.h>
-#include <unordered_set>
+#include <sstream>
+#include <test/benchmark.h>
 
 using namespace snmalloc;
 
+// Preallocated, so that the timings do not include any bookkeeping.
+void** objects;
+
+std::string name(size_t count, size_t size, bool zero, bool write)
+{
+  std::ostringstream s;
+  s << "Count: " << std::setw(6) << count << ", Size: " << std::setw(6) << size
+    << ", ZeroMem: " << zero << ", Write: " << write;
+  return s.str();
+}
+
 template<ZeroMem zero_mem>
-void test_alloc_dealloc(size_t count, size_t size, bool write)
+void test_alloc_dealloc(
+  benchmark::Harness& harness, size_t count, size_t size, bool write)
 {
-  auto* alloc = ThreadAlloc::get();
+  auto alloc = ThreadAlloc::get();
+  size_t total = ((count * 3) / 2) + count;
+  objects = new void*[total];
 
-  DO_TIME(
-    "Count: " << std::setw(6) << count << ", Size: " << std::setw(6) << size
-              << ", ZeroMem: " << (zero_mem == YesZero) << ", Write: " << write,
+  harness.run(name(count, size, zero_mem == YesZero, write), [&]() {
+    size_t n = 0;
+
+    // alloc 1.5x objects
+    for (size_t i = 0; i < ((count * 3) / 2); i++)
     {
-      std::unordered_set<void*> set;
-
-      // alloc 1.5x objects
-      for (size_t i = 0; i < ((count * 3) / 2); i++)
-      {
-        void* p = alloc->alloc<zero_mem>(size);
-        assert(set.find(p) == set.end());
-
-        if (write)
-          *(int*)p = 4;
-
-        set.insert(p);
-      }
-
-      // free 0.25x of the objects
-      for (size_t i = 0; i < (count / 4); i++)
-      {
-        auto it = set.begin();
-        void* p = *it;
-        alloc->dealloc(p, size);
-        set.erase(it);
-        assert(set.find(p) == set.end());
-      }
-
-      // alloc 1x objects
-      for (size_t i = 0; i < count; i++)
-      {
-        void* p = alloc->alloc<zero_mem>(size);
-        assert(set.find(p) == set.end());
-
-        if (write)
-          *(int*)p = 4;
-
-        set.insert(p);
-      }
-
-      // free everything
-      while (!set.empty())
-      {
-        auto it = set.begin();
-        alloc->dealloc(*it, size);
-        set.erase(it);
-      }
-    });
+      void* p = alloc->alloc<zero_mem>(size);
+
+      if (write)
+        *(int*)p = 4;
+
+      objects[n++] = p;
+    }
+
+    // free 0.25x of the objects
+    size_t first = count / 4;
+    for (size_t i = 0; i < first; i++)
+      alloc->dealloc(objects[i], size);
 
+    // alloc 1x objects
+    for (size_t i = 0; i < count; i++)
+    {
+      void* p = alloc->alloc<zero_mem>(size);
+
+      if (write)
+        *(int*)p = 4;
+
+      objects[n++] = p;
+    }
+
+#ifndef NDEBUG
+    // Check that no live object was handed out twice.
+    std::sort(objects + first, objects + n);
+    if (std::adjacent_find(objects + first, objects + n) != objects + n)
+      abort();
+#endif
+
+    // free everything
+    for (size_t i = first; i < n; i++)
+      alloc->dealloc(objects[i], size);
+  });
+
+  delete[] objects;
   current_alloc_pool()->debug_check_empty();
 }
 
-int main(int, char**)
+int main(int argc, char** argv)
 {
+  opt::Opt opt(argc, argv);
+  benchmark::Harness harness(opt);
+
   for (size_t size = 16; size <= 128; size <<= 1)
   {
-    test_alloc_dealloc<NoZero>(1 << 15, size, false);
-    test_alloc_dealloc<NoZero>(1 << 15, size, true);
-    test_alloc_dealloc<YesZero>(1 << 15, size, false);
-    test_alloc_dealloc<YesZero>(1 << 15, size, true);
+    test_alloc_dealloc<NoZero>(harness, 1 << 15, size, false);
+    test_alloc_dealloc<NoZero>(harness, 1 << 15, size, true);
+    test_alloc_dealloc<YesZero>(harness, 1 << 15, size, false);
+    test_alloc_dealloc<YesZero>(harness, 1 << 15, size, true);
   }
 
   for (size_t size = 1 << 12; size <= 1 << 17; size <<= 1)
   {
-    test_alloc_dealloc<NoZero>(1 << 10, size, false);
-    test_alloc_dealloc<NoZero>(1 << 10, size, true);
-    test_alloc_dealloc<YesZero>(1 << 10, size, false);
-    test_alloc_dealloc<YesZero>(1 << 10, size, true);
+    test_alloc_dealloc<NoZero>(harness, 1 << 10, size, false);
+    test_alloc_dealloc<NoZero>(harness, 1 << 10, size, true);
+    test_alloc_dealloc<YesZero>(harness, 1 << 10, size, false);
+    test_alloc_dealloc<YesZero>(harness, 1 << 10, size, true);
   }
 
   return 0;
@@ -0,0 +1,86 @@
+#include <map>
+#include <memory_resource>
+#include <snmalloc.h>
+#include <test/benchmark.h>
+#include <test/xoroshiro.h>
+#include <unordered_map>
+
+using namespace snmalloc;
+
+// Compare standard containers using the global `operator new`, which cannot
+// see the static size of a node, with the same containers using the snmalloc
+// adaptors.
+
+using Key = uint64_t;
+using Pair = std::pair<const Key, Key>;
+
+benchmark::Harness* harness;
+
+template<class Map>
+void churn(const char* name, size_t count, size_t rounds, Map& map)
+{
+  xoroshiro::p128r32 r;
+
+  harness->run(
+    std::string(name) + ", " + std::to_string(count) + " keys, " +
+      std::to_string(rounds) + " rounds",
+    [&]() {
+      for (size_t n = 0; n < rounds; n++)
+      {
+        for (size_t i = 0; i < count; i++)
+          map[r.next()] = i;
+
+        map.clear();
+      }
+    });
+}
+
+template<template<class...> class Map, class... Args>
+void test_map(const char* name, size_t count, size_t rounds)
+{
+  {
+    Map<Key, Key, Args..., std::allocator<Pair>> map;
+    churn((std::string(name) + ", operator new").c_str(), count, rounds, map);
+  }
+
+  {
+    Map<Key, Key, Args..., STLAllocator<Pair>> map;
+    churn((std::string(name) + ", STLAllocator").c_str(), count, rounds, map);
+  }
+
+  {
+    Alloc* alloc = current_alloc_pool()->acquire();
+    STLAllocator<Pair, Alloc> bound(alloc);
+    {
+      Map<Key, Key, Args..., STLAllocator<Pair, Alloc>> map(bound);
+      churn(
+        (std::string(name) + ", STLAllocator<Alloc>").c_str(),
+        count,
+        rounds,
+        map);
+    }
+    current_alloc_pool()->release(alloc);
+  }
+
+  {
+    MemoryResource<> resource;
+    std::pmr::polymorphic_allocator<Pair> pa(&resource);
+    Map<Key, Key, Args..., std::pmr::polymorphic_allocator<Pair>> map(pa);
+    churn((std::string(name) + ", MemoryResource").c_str(), count, rounds, map);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  size_t count = opt.is<size_t>("--count", 1 << 16);
+  size_t rounds = opt.is<size_t>("--rounds", 20);
+  benchmark::Harness h(opt, 5);
+  harness = &h;
+
+  test_map<std::map, std::less<Key>>("map", count, rounds);
+  test_map<std::unordered_map, std::hash<Key>, std::equal_to<Key>>(
+    "unordered_map", count, rounds);
+
+  return 0;
+}
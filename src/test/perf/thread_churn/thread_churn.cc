@@ -0,0 +1,252 @@
+#include "test/opt.h"
+#include "test/xoroshiro.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <snmalloc.h>
+#include <vector>
+
+using namespace snmalloc;
+
+#if !defined(_WIN32) && !defined(OPEN_ENCLAVE)
+#  include <pthread.h>
+
+// Creates and destroys many short-lived threads, as a server that spawns a
+// thread per request does.  Every thread acquires an allocator from the
+// global pool on its first allocation and releases it when it exits, so
+// this measures the cost of thread start up, how often allocators are
+// reused rather than created, and how much memory is stranded in allocators
+// that have been released.
+//
+// Each thread allocates a few hundred objects, frees most of them, frees the
+// objects left behind by an earlier thread, and leaves some of its own for a
+// later thread to free.
+//
+// Threads are created with pthreads directly, as std::thread allocates and
+// frees its state with operator new and delete, which would give every
+// thread an allocator before its first timed allocation.
+
+using Clock = std::chrono::steady_clock;
+
+size_t objects;
+
+std::mutex handoff_lock;
+std::vector<void*>* handoff;
+
+struct Timing
+{
+  size_t seed;
+  Clock::time_point spawned;
+  // From creating the thread to the thread running.
+  Clock::duration start;
+  // The first allocation, which acquires an allocator for the thread.
+  Clock::duration first_alloc;
+};
+
+void* run(void* arg)
+{
+  Timing* timing = (Timing*)arg;
+  auto running = Clock::now();
+  timing->start = running - timing->spawned;
+
+  // This must be the first allocation on the thread.
+  auto before = Clock::now();
+  void* first = ThreadAlloc::get()->alloc(16);
+  timing->first_alloc = Clock::now() - before;
+
+  auto a = ThreadAlloc::get();
+  xoroshiro::p128r32 r(timing->seed);
+  std::vector<void*> mine(objects);
+  mine[0] = first;
+
+  for (size_t i = 1; i < objects; i++)
+    mine[i] = a->alloc(16 + (r.next() % 1024));
+
+  std::vector<void*> left;
+
+  {
+    std::lock_guard<std::mutex> guard(handoff_lock);
+    left.swap(*handoff);
+
+    // Leave a quarter of the objects for a later thread.
+    for (size_t i = 0; i < objects; i += 4)
+    {
+      handoff->push_back(mine[i]);
+      mine[i] = nullptr;
+    }
+  }
+
+  for (void* p : mine)
+  {
+    if (p != nullptr)
+      a->dealloc(p);
+  }
+
+  for (void* p : left)
+    a->dealloc(p);
+
+  return nullptr;
+}
+
+/**
+ * Bytes of objects that `a` has allocated and not yet seen freed.  For a
+ * released allocator, this includes objects that other threads have freed
+ * but that are still waiting in its message queue or in the remote caches
+ * of other released allocators.
+ */
+size_t live_bytes(Alloc* a)
+{
+  Stats& stats = a->stats();
+  size_t bytes = 0;
+
+  for (size_t i = 0; i < NUM_SIZECLASSES; i++)
+  {
+    auto& c = stats.sizeclass_counters[i];
+    if (c.allocs > c.frees)
+      bytes += (c.allocs - c.frees) * sizeclass_to_size((uint8_t)i);
+  }
+
+  return bytes;
+}
+
+void report_stranded(const char* when, Alloc* self)
+{
+  auto* pool = current_alloc_pool();
+  size_t released = 0;
+  size_t live = 0;
+  // A chunk can be committed by one allocator and released by another, so
+  // this partial sum can be negative.
+  ptrdiff_t committed = 0;
+
+  for (Alloc* a = pool->iterate(); a != nullptr; a = pool->iterate(a))
+  {
+    if (a == self)
+      continue;
+
+    released++;
+    live += live_bytes(a);
+    committed += a->stats().committed;
+  }
+
+  std::cout << std::setw(16) << when << ": " << released
+            << " released allocators hold " << (live >> 10)
+            << " KiB of objects and " << (committed / (1 << 20))
+            << " MiB committed" << std::endl;
+}
+
+void report_latency(const char* name, std::vector<Clock::duration>& times)
+{
+  std::sort(times.begin(), times.end());
+
+  auto at = [&](size_t p) {
+    return (size_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             times[((times.size() - 1) * p) / 100])
+      .count();
+  };
+
+  std::cout << std::setw(16) << name << ": median " << std::setw(8) << at(50)
+            << " ns, p90 " << std::setw(8) << at(90) << " ns, p99 "
+            << std::setw(8) << at(99) << " ns" << std::endl;
+}
+
+void test_churn(size_t threads, size_t concurrent)
+{
+  auto* pool = current_alloc_pool();
+  auto self = ThreadAlloc::get();
+  size_t before = pool->allocator_count();
+
+  std::vector<Timing> timings(threads);
+  std::vector<pthread_t> running(concurrent);
+  handoff = new std::vector<void*>;
+
+  auto start = Clock::now();
+
+  for (size_t t = 0; t < threads; t += concurrent)
+  {
+    size_t end = (std::min)(t + concurrent, threads);
+
+    for (size_t i = t; i < end; i++)
+    {
+      timings[i].seed = i + 1;
+      timings[i].spawned = Clock::now();
+      pthread_create(&running[i - t], nullptr, run, &timings[i]);
+    }
+
+    for (size_t i = t; i < end; i++)
+      pthread_join(running[i - t], nullptr);
+  }
+
+  auto total = Clock::now() - start;
+  size_t created = pool->allocator_count() - before;
+
+  std::cout << threads << " threads, " << concurrent << " at a time, "
+            << objects << " objects each: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(total)
+                 .count()
+            << " ms" << std::endl;
+  std::cout << std::setw(16) << "allocators"
+            << ": " << created << " created, " << (threads - created)
+            << " reused" << std::endl;
+
+  {
+    std::vector<Clock::duration> start_times;
+    std::vector<Clock::duration> first_alloc_times;
+
+    for (auto& timing : timings)
+    {
+      start_times.push_back(timing.start);
+      first_alloc_times.push_back(timing.first_alloc);
+    }
+
+    report_latency("thread start", start_times);
+    report_latency("first alloc", first_alloc_times);
+  }
+
+  report_stranded("after churn", &*self);
+
+  // Released allocators only process their message queues when a thread
+  // reuses them, or when the pool is asked to clean them up.
+  pool->cleanup_unused();
+  report_stranded("after cleanup", &*self);
+
+  for (void* p : *handoff)
+    self->dealloc(p);
+
+  delete handoff;
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+#if NDEBUG
+  size_t threads = opt.is<size_t>("--threads", 4096);
+#else
+  size_t threads = opt.is<size_t>("--threads", 256);
+#endif
+  size_t concurrent = opt.is<size_t>("--concurrent", 8);
+  objects = opt.is<size_t>("--objects", 256);
+
+  if ((threads == 0) || (concurrent == 0) || (objects == 0))
+  {
+    std::cout << "Counts must be at least one" << std::endl;
+    return 1;
+  }
+
+  test_churn(threads, concurrent);
+
+#ifndef NDEBUG
+  current_alloc_pool()->debug_check_empty();
+#endif
+
+  return 0;
+}
+#else
+int main(int, char**)
+{
+  std::cout << "The thread churn benchmark needs pthreads" << std::endl;
+  return 0;
+}
+#endif
@@ -0,0 +1,362 @@
+#include "test/opt.h"
+#include "test/xoroshiro.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <snmalloc.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace snmalloc;
+
+// Replays an allocation trace recorded by the malloc shim with
+// `SNMALLOC_TRACE_FILE` against `Alloc`.  Each thread in the trace is mapped
+// to one of `--threads` replay threads, which perform its events in order.
+// A free of an object allocated by another replay thread waits until that
+// allocation has been replayed, so objects still move between threads as
+// they did when the trace was recorded.
+//
+// Without `--trace`, a short trace is recorded from a synthetic workload and
+// replayed, which checks that recording and replay agree.  The allocator's
+// environment variables apply to the replay, so the same trace can be used
+// to compare configurations.
+
+struct Op
+{
+  TraceKind kind;
+  size_t object;
+  size_t previous;
+  size_t size;
+};
+
+// No object, for a `realloc` of nullptr or a free of an unknown pointer.
+static constexpr size_t NO_OBJECT = ~(size_t)0;
+
+struct Object
+{
+  std::atomic<void*> p{nullptr};
+  size_t size = 0;
+  // Whether the object is still live at the end of the trace.
+  bool live = false;
+};
+
+std::vector<std::vector<Op>> ops;
+Object* objects;
+
+void* wait_for(size_t object)
+{
+  void* p;
+
+  while ((p = objects[object].p.load(std::memory_order_acquire)) == nullptr)
+    bits::pause();
+
+  return p;
+}
+
+void replay(size_t id)
+{
+  auto a = ThreadAlloc::get();
+
+  for (auto& op : ops[id])
+  {
+    void* p;
+
+    switch (op.kind)
+    {
+      case TraceMalloc:
+        p = a->alloc(op.size);
+        break;
+
+      case TraceCalloc:
+        p = a->alloc<ZeroMem::YesZero>(op.size);
+        break;
+
+      case TraceRealloc:
+        p = a->alloc(op.size);
+        if (op.previous != NO_OBJECT)
+        {
+          void* old = wait_for(op.previous);
+          memcpy(p, old, (std::min)(op.size, objects[op.previous].size));
+          a->dealloc(old);
+        }
+        break;
+
+      case TraceFree:
+        a->dealloc(wait_for(op.object));
+        continue;
+
+      default:
+        abort();
+    }
+
+    objects[op.object].p.store(p, std::memory_order_release);
+  }
+}
+
+/**
+ * Turn the addresses in the trace into object numbers, and split the events
+ * between replay threads.  Returns the number of objects.
+ */
+size_t prepare(TraceHeader* h, size_t threads)
+{
+  std::unordered_map<uint64_t, size_t> live;
+  std::vector<size_t> sizes;
+  TraceEvent* events = h->events();
+  size_t recorded = h->recorded();
+
+  ops.assign(threads, {});
+
+  auto allocate = [&](uint64_t address, size_t size) {
+    // Sizes of zero are allocated in the smallest sizeclass.
+    size = (std::max)(size, (size_t)1);
+    sizes.push_back(size);
+    live[address] = sizes.size() - 1;
+    return sizes.size() - 1;
+  };
+
+  auto release = [&](uint64_t address) {
+    auto it = live.find(address);
+
+    if (it == live.end())
+      return NO_OBJECT;
+
+    size_t object = it->second;
+    live.erase(it);
+    return object;
+  };
+
+  for (size_t i = 0; i < recorded; i++)
+  {
+    TraceEvent& e = events[i];
+    TraceKind kind = e.kind.load(std::memory_order_relaxed);
+    Op op{kind, NO_OBJECT, NO_OBJECT, e.size};
+
+    switch (kind)
+    {
+      case TraceMalloc:
+      case TraceCalloc:
+        op.object = allocate(e.object, e.size);
+        op.size = sizes[op.object];
+        break;
+
+      case TraceRealloc:
+        op.previous = release(e.previous);
+        op.object = allocate(e.object, e.size);
+        op.size = sizes[op.object];
+        break;
+
+      case TraceFree:
+        // Objects allocated before the trace started are not replayed.
+        op.object = release(e.object);
+        if (op.object == NO_OBJECT)
+          continue;
+        break;
+
+      default:
+        // Incomplete when the trace was written.
+        continue;
+    }
+
+    ops[e.thread % threads].push_back(op);
+  }
+
+  objects = new Object[sizes.size()];
+
+  for (size_t i = 0; i < sizes.size(); i++)
+    objects[i].size = sizes[i];
+
+  for (auto& l : live)
+    objects[l.second].live = true;
+
+  return sizes.size();
+}
+
+void test_replay(TraceHeader* h, size_t threads)
+{
+  size_t count = prepare(h, threads);
+  size_t events = 0;
+
+  for (auto& t : ops)
+    events += t.size();
+
+  auto start = std::chrono::steady_clock::now();
+
+  {
+    std::vector<std::thread> running;
+
+    for (size_t t = 0; t < threads; t++)
+      running.emplace_back(replay, t);
+
+    for (auto& t : running)
+      t.join();
+  }
+
+  auto finish = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(finish - start).count();
+
+  snmalloc_stats_t* s = new snmalloc_stats_t;
+  stats_snapshot(s);
+
+  std::cout << "Replayed " << events << " events on " << threads
+            << " threads: " << std::setw(10)
+            << (size_t)((double)events / seconds) << " events/s, "
+            << (s->committed >> 20) << " MiB committed, "
+            << (s->reserved >> 20) << " MiB reserved" << std::endl;
+
+  delete s;
+
+  auto a = ThreadAlloc::get();
+
+  for (size_t i = 0; i < count; i++)
+  {
+    if (objects[i].live)
+      a->dealloc(objects[i].p.load());
+  }
+
+  delete[] objects;
+  ops.clear();
+  ops.shrink_to_fit();
+}
+
+/**
+ * Record a synthetic workload.  Each thread keeps a window of objects,
+ * resizing some and passing others to the next thread to free.
+ */
+void record(AllocTrace& trace, size_t threads, size_t rounds)
+{
+  std::vector<std::atomic<void*>> handoff(threads);
+  std::vector<std::thread> running;
+
+  for (size_t t = 0; t < threads; t++)
+  {
+    running.emplace_back([&, t]() {
+      auto a = ThreadAlloc::get();
+      xoroshiro::p128r32 r(t + 1);
+      void* window[64] = {};
+
+      for (size_t n = 0; n < rounds; n++)
+      {
+        size_t i = r.next() % 64;
+        size_t size = 16 + (r.next() % 4096);
+
+        if (window[i] == nullptr)
+        {
+          bool zero = (r.next() % 4) == 0;
+          window[i] = zero ? a->alloc<ZeroMem::YesZero>(size) : a->alloc(size);
+          trace.record(zero ? TraceCalloc : TraceMalloc, window[i], size);
+        }
+        else if ((r.next() % 4) == 0)
+        {
+          void* p = a->alloc(size);
+          memcpy(p, window[i], 16);
+          trace.record(TraceRealloc, p, size, window[i]);
+          a->dealloc(window[i]);
+          window[i] = p;
+        }
+        else
+        {
+          // Swap with the next thread, and free whatever it left.
+          void* out = handoff[(t + 1) % threads].exchange(window[i]);
+          window[i] = nullptr;
+
+          if (out != nullptr)
+          {
+            trace.record(TraceFree, out, 0);
+            a->dealloc(out);
+          }
+        }
+      }
+
+      for (size_t i = 0; i < 64; i++)
+      {
+        if (window[i] != nullptr)
+        {
+          trace.record(TraceFree, window[i], 0);
+          a->dealloc(window[i]);
+        }
+      }
+    });
+  }
+
+  for (auto& t : running)
+    t.join();
+
+  // Free these without recording it, so that the trace ends with live
+  // objects, which the replay must free itself.
+  for (auto& h : handoff)
+  {
+    if (h != nullptr)
+      ThreadAlloc::get()->dealloc(h.load());
+  }
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  const char* path = opt.is("--trace", (const char*)nullptr);
+  size_t threads = opt.is<size_t>("--threads", 0);
+  bool synthetic = path == nullptr;
+  char synthetic_path[] = "snmalloc_trace_replay.trace";
+
+  if (synthetic)
+  {
+#if NDEBUG
+    size_t rounds = opt.is<size_t>("--rounds", 1 << 18);
+#else
+    size_t rounds = opt.is<size_t>("--rounds", 1 << 14);
+#endif
+    path = synthetic_path;
+    AllocTrace trace;
+
+    if (!trace.open(path, rounds * 8))
+    {
+      std::cout << "Tracing is not supported on this platform" << std::endl;
+      return 0;
+    }
+
+    record(trace, 4, rounds);
+    trace.stop();
+  }
+
+  TraceHeader* h = AllocTrace::read(path);
+
+  if (h == nullptr)
+  {
+    std::cout << "Cannot read trace " << path << std::endl;
+    return 1;
+  }
+
+  size_t recorded = h->recorded();
+  uint32_t trace_threads = 0;
+
+  for (size_t i = 0; i < recorded; i++)
+    trace_threads = (std::max)(trace_threads, h->events()[i].thread + 1);
+
+  std::cout << "Trace has " << recorded << " events from " << trace_threads
+            << " threads";
+  if (h->count > h->capacity)
+    std::cout << ", " << (h->count - h->capacity) << " dropped";
+  std::cout << std::endl;
+
+  if (threads != 0)
+  {
+    test_replay(h, threads);
+  }
+  else
+  {
+    for (size_t t = (std::max)(trace_threads, (uint32_t)1); t > 0; t >>= 1)
+      test_replay(h, t);
+  }
+
+  if (synthetic)
+    remove(path);
+
+#ifndef NDEBUG
+  current_alloc_pool()->debug_check_empty();
+#endif
+
+  return 0;
+}
@@ -0,0 +1,167 @@
+#include "test/benchmark.h"
+#include "test/xoroshiro.h"
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <snmalloc.h>
+#include <thread>
+#include <vector>
+
+using namespace snmalloc;
+
+// A port of the xmalloc test by Lever and Boreham.  Every thread allocates
+// a batch of objects and puts it on a shared list, then takes whichever
+// batch is at the head of the list and frees it.  Batches are usually freed
+// by a different thread from the one that allocated them, so this stresses
+// remote frees arriving in bulk rather than one at a time.
+
+bool use_malloc = false;
+
+size_t batch_size;
+size_t batches;
+size_t max_size;
+
+struct Batch
+{
+  Batch* next;
+  void* objects[1];
+};
+
+std::mutex lock;
+Batch* shared = nullptr;
+
+void* test_alloc(size_t size)
+{
+  if (use_malloc)
+    return malloc(size);
+
+  return ThreadAlloc::get()->alloc(size);
+}
+
+void test_free(void* p, size_t size)
+{
+  if (use_malloc)
+    free(p);
+  else
+    ThreadAlloc::get()->dealloc(p, size);
+}
+
+size_t batch_bytes()
+{
+  return sizeof(Batch) + ((batch_size - 1) * sizeof(void*));
+}
+
+void push(Batch* b)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  b->next = shared;
+  shared = b;
+}
+
+Batch* pop()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  Batch* b = shared;
+
+  if (b != nullptr)
+    shared = b->next;
+
+  return b;
+}
+
+void free_batch(Batch* b)
+{
+  for (size_t i = 0; i < batch_size; i++)
+    test_free(b->objects[i], *(size_t*)b->objects[i]);
+
+  test_free(b, batch_bytes());
+}
+
+void run(size_t id)
+{
+  xoroshiro::p128r32 r(id + 1);
+
+  for (size_t n = 0; n < batches; n++)
+  {
+    Batch* b = (Batch*)test_alloc(batch_bytes());
+
+    for (size_t i = 0; i < batch_size; i++)
+    {
+      size_t size = sizeof(size_t) + (r.next() % (max_size - sizeof(size_t)));
+      size_t* p = (size_t*)test_alloc(size);
+      *p = size;
+      b->objects[i] = p;
+    }
+
+    push(b);
+
+    b = pop();
+    if (b != nullptr)
+      free_batch(b);
+  }
+}
+
+void test_xmalloc(benchmark::Harness& harness, size_t threads)
+{
+  harness.run(
+    "xmalloc, " + std::to_string(threads) + " threads, " +
+      std::to_string(batches) + " batches of " + std::to_string(batch_size),
+    [&]() {
+      auto start = std::chrono::steady_clock::now();
+
+      {
+        std::vector<std::thread> running;
+
+        for (size_t t = 0; t < threads; t++)
+          running.emplace_back(run, t);
+
+        for (auto& t : running)
+          t.join();
+      }
+
+      auto finish = std::chrono::steady_clock::now();
+
+      // Batches left on the list are not part of the measurement.
+      while (Batch* b = pop())
+        free_batch(b);
+
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        finish - start);
+    });
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  size_t cores = opt.is<size_t>("--cores", 8);
+  batch_size = opt.is<size_t>("--batch", 4096);
+  max_size = opt.is<size_t>("--max", 128);
+#if NDEBUG
+  batches = opt.is<size_t>("--batches", 256);
+#else
+  batches = opt.is<size_t>("--batches", 16);
+#endif
+  use_malloc = opt.has("--use_malloc");
+  benchmark::Harness harness(opt, 5);
+
+  if ((max_size <= sizeof(size_t)) || (batch_size == 0))
+  {
+    std::cout << "Sizes must be more than " << sizeof(size_t) << " bytes"
+              << std::endl;
+    return 1;
+  }
+
+  std::cout << "Allocator is " << (use_malloc ? "System" : "snmalloc")
+            << std::endl;
+
+  for (size_t i = cores; i > 0; i >>= 1)
+    test_xmalloc(harness, i);
+
+#ifndef NDEBUG
+  if (!use_malloc)
+    current_alloc_pool()->debug_check_empty();
+#endif
+
+  return 0;
+}
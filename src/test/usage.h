@@ -6,6 +6,12 @@
 #  include <windows.h>
 // Needs to be included after windows.h
 #  include <psapi.h>
+#elif defined(__linux__)
+#  include <atomic>
+#  include <chrono>
+#  include <stdio.h>
+#  include <thread>
+#  include <unistd.h>
 #endif
 
 #include <iomanip>
@@ -13,6 +19,105 @@
 
 namespace usage
 {
+#if defined(__linux__)
+  /**
+   * Resident set size in bytes, from `/proc/self/statm`.  Returns 0 if it
+   * cannot be read.
+   */
+  inline size_t rss()
+  {
+    FILE* f = fopen("/proc/self/statm", "r");
+    unsigned long size = 0;
+    unsigned long resident = 0;
+
+    if (f == nullptr)
+      return 0;
+
+    if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+      resident = 0;
+
+    fclose(f);
+    return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+  }
+
+  /**
+   * Proportional set size in bytes, from `/proc/self/smaps_rollup`, which
+   * charges shared pages to each process in proportion.  Returns 0 if it
+   * cannot be read, as on kernels before 4.14.
+   */
+  inline size_t pss()
+  {
+    FILE* f = fopen("/proc/self/smaps_rollup", "r");
+    char line[256];
+    unsigned long kb = 0;
+
+    if (f == nullptr)
+      return 0;
+
+    while (fgets(line, sizeof(line), f) != nullptr)
+    {
+      if (sscanf(line, "Pss: %lu kB", &kb) == 1)
+        break;
+    }
+
+    fclose(f);
+    return (size_t)kb * 1024;
+  }
+
+  /**
+   * Samples the resident set size on a background thread, to catch peaks
+   * between the points at which a benchmark measures it.
+   */
+  class RssSampler
+  {
+    std::atomic<bool> running{true};
+    std::atomic<size_t> peak_rss{0};
+    std::thread thread;
+
+    void sample(std::chrono::microseconds interval)
+    {
+      while (running.load())
+      {
+        size_t r = rss();
+        size_t p = peak_rss.load();
+
+        while ((r > p) && !peak_rss.compare_exchange_weak(p, r))
+        {}
+
+        std::this_thread::sleep_for(interval);
+      }
+    }
+
+  public:
+    RssSampler(
+      std::chrono::microseconds interval = std::chrono::milliseconds(1))
+    : thread(&RssSampler::sample, this, interval)
+    {}
+
+    ~RssSampler()
+    {
+      running = false;
+      thread.join();
+    }
+
+    /**
+     * Highest resident set size seen since the sampler started or was last
+     * reset.
+     */
+    size_t peak()
+    {
+      size_t r = rss();
+      size_t p = peak_rss.load();
+      return r > p ? r : p;
+    }
+
+    void reset()
+    {
+      peak_rss = rss();
+    }
+  };
+#endif
+
   void print_memory()
   {
 #if defined(_WIN32)
@@ -37,6 +142,10 @@ namespace usage
               << "\tPagefileUsage: " << pmc.PagefileUsage << std::endl
               << "\tPeakPagefileUsage: " << pmc.PeakPagefileUsage << std::endl
               << "\tPrivateUsage: " << pmc.PrivateUsage << std::endl;
+#elif defined(__linux__)
+    std::cout << "Memory info:" << std::endl
+              << "\tRss: " << rss() << std::endl
+              << "\tPss: " << pss() << std::endl;
 #endif
   }
 };